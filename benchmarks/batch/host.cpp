@@ -0,0 +1,57 @@
+/*
+   Copyright 2019 Atikur Rahman Chitholian
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+#include <chrono>
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+
+/**
+ * Host side of the batch benchmark: calls the uCML function score() once per row, then once for all rows through
+ * the generated batch entry point, and compares the two.
+ */
+extern "C" double score(double price, int64_t quantity);
+
+extern "C" void score_batch(const double *price, const int64_t *quantity, double *out, size_t n);
+
+int main(int argc, char *argv[]) {
+    size_t rows = argc > 1 ? strtoull(argv[1], nullptr, 10) : 10000000;
+    std::vector<double> price(rows), perRow(rows), batch(rows);
+    std::vector<int64_t> quantity(rows);
+    srand(42);
+    for (size_t i = 0; i < rows; ++i) {
+        price[i] = rand() % 10000 / 100.0;
+        quantity[i] = rand() % 200;
+    }
+
+    auto startTime = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < rows; ++i) perRow[i] = score(price[i], quantity[i]);
+    auto middleTime = std::chrono::steady_clock::now();
+    score_batch(price.data(), quantity.data(), batch.data(), rows);
+    auto endTime = std::chrono::steady_clock::now();
+
+    for (size_t i = 0; i < rows; ++i) {
+        if (perRow[i] != batch[i]) {
+            printf("Mismatch at row %zu: %f != %f\n", i, perRow[i], batch[i]);
+            return 1;
+        }
+    }
+    double rowNs = std::chrono::duration<double, std::nano>(middleTime - startTime).count() / rows,
+            batchNs = std::chrono::duration<double, std::nano>(endTime - middleTime).count() / rows;
+    printf("%zu rows: per-row calls %.2f ns/row, batch %.2f ns/row, %.1fx faster\n", rows, rowNs, batchNs,
+           rowNs / batchNs);
+    return 0;
+}
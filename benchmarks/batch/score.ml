@@ -0,0 +1,10 @@
+/**
+*  Scalar function applied to every row by the batch benchmark (run-batch.sh); the library build emits score_batch()
+*/
+def score(price:double, quantity:int):double => {
+    discount:double = 0.0
+    if (quantity > 100) {
+        discount = 0.1
+    }
+    return price * quantity * (1.0 - discount) + 2.5
+}
@@ -0,0 +1,22 @@
+/**
+*  Multi-way dispatch with a chain of if/else (compare against dispatch_match.ml)
+*/
+def score(code:int):int => {
+    if (code == 0 || code == 7 || code == 19) { return 3 }
+    if (code >= 1 && code <= 6) { return 1 }
+    if (code >= 8 && code <= 18) { return 2 }
+    if (code >= 20 && code <= 40) { return 5 }
+    if (code == 41 || code == 43 || code == 45 || code == 47) { return 7 }
+    if (code >= 48 && code <= 62) { return 4 }
+    return 0
+}
+
+def run(n:int):int => {
+    total:int = 0
+    for(i:int in 1 to n) {
+        total = total + score((i * 37 + 11) % 64)
+    }
+    return total
+}
+
+echo(run(200000000))
@@ -0,0 +1,25 @@
+/**
+*  Multi-way dispatch with a single match (compare against dispatch_if.ml)
+*/
+def score(code:int):int => {
+    match (code) {
+        0, 7, 19 => { return 3 }
+        1 to 6 => { return 1 }
+        8 to 18 => { return 2 }
+        20 to 40 => { return 5 }
+        41, 43, 45, 47 => { return 7 }
+        48 to 62 => { return 4 }
+        _ => { return 0 }
+    }
+    return 0
+}
+
+def run(n:int):int => {
+    total:int = 0
+    for(i:int in 1 to n) {
+        total = total + score((i * 37 + 11) % 64)
+    }
+    return total
+}
+
+echo(run(200000000))
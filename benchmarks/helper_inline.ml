@@ -0,0 +1,15 @@
+/**
+*  Host helpers linked as IR and inlined into the loop (compare against helper_native.ml)
+*/
+extern hash(x:int):int
+extern clamp(x:double, low:double, high:double):double
+
+def run(n:int):double => {
+    total:double = 0
+    for(i:int in 1 to n) {
+        total = total + clamp(double(hash(i) % 1000), 100, 900)
+    }
+    return total
+}
+
+echo(run(100000000))
@@ -0,0 +1,15 @@
+/**
+*  Host helpers bound as native functions, called every iteration (compare against helper_inline.ml)
+*/
+extern hash_native(x:int):int
+extern clamp_native(x:double, low:double, high:double):double
+
+def run(n:int):double => {
+    total:double = 0
+    for(i:int in 1 to n) {
+        total = total + clamp_native(double(hash_native(i) % 1000), 100, 900)
+    }
+    return total
+}
+
+echo(run(100000000))
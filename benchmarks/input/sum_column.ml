@@ -0,0 +1,12 @@
+/**
+*  Sum a binary column of 64-bit integers: uCML --input=<file> sum_column.ml
+*/
+def sum(stream:int):int => {
+    total:int = 0
+    for (row:int in 0 to rows(stream) - 1) {
+        total = total + intat(stream, row)
+    }
+    return total
+}
+
+echo(sum(1))
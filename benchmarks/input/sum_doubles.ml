@@ -0,0 +1,15 @@
+/**
+*  Sum the decimal numbers of a text file: uCML --input=<file> sum_doubles.ml
+*/
+def sum(stream:int):double => {
+    total:double = 0
+    for (i:int in 1 to 9223372036854775806) {
+        if (ended(stream)) {
+            return total
+        }
+        total = total + readdouble(stream)
+    }
+    return total
+}
+
+echo(sum(1))
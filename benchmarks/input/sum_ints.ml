@@ -0,0 +1,15 @@
+/**
+*  Sum the integers of a text file: uCML --input=<file> sum_ints.ml
+*/
+def sum(stream:int):int => {
+    total:int = 0
+    for (i:int in 1 to 9223372036854775806) {
+        if (ended(stream)) {
+            return total
+        }
+        total = total + readint(stream)
+    }
+    return total
+}
+
+echo(sum(1))
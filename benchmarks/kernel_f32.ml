@@ -0,0 +1,13 @@
+/**
+*  Polynomial kernel in single precision (compare against kernel_f64.ml)
+*/
+def kernel(n:i32):float => {
+    sum:float = 0
+    for(i:i32 in 1 to n) {
+        x:float = float(i) * 0.0000001
+        sum = sum + (((x * 0.5 + 1.5) * x - 2.25) * x + 0.75) * x
+    }
+    return sum
+}
+
+echo(kernel(100000000))
@@ -0,0 +1,13 @@
+/**
+*  Polynomial kernel in double precision (compare against kernel_f32.ml)
+*/
+def kernel(n:int):double => {
+    sum:double = 0
+    for(i:int in 1 to n) {
+        x:double = double(i) * 0.0000001
+        sum = sum + (((x * 0.5 + 1.5) * x - 2.25) * x + 0.75) * x
+    }
+    return sum
+}
+
+echo(kernel(100000000))
@@ -0,0 +1,9 @@
+/**
+*  Work for the thread scaling benchmark (run-scaling.sh); every concurrent run has its own "checksum"
+*/
+checksum:int = 0
+
+for(i:int in 1 to 50000000) {
+    checksum = (checksum * 31 + i) % 1000003
+}
+echo(checksum)
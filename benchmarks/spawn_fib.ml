@@ -0,0 +1,14 @@
+/**
+*  Recursive Fibonacci, one branch spawned at every level; tasks deep down run inline.
+*  Run with --workers=<n> to compare thread counts (make bench does).
+*/
+def fib(n:int):int => {
+    if (n < 2) {
+        return n
+    }
+    left:task = spawn fib(n - 1)
+    right:int = fib(n - 2)
+    return join(left) + right
+}
+
+echo(fib(36))
@@ -0,0 +1,74 @@
+/*
+   Copyright 2019 Atikur Rahman Chitholian
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+#include <llvm/IR/Module.h>
+#include "cache.hpp"
+
+namespace ucml {
+    void ObjectCache::notifyObjectCompiled(const llvm::Module *module, llvm::MemoryBufferRef object) {
+        objects[module->getModuleIdentifier()] = llvm::MemoryBuffer::getMemBufferCopy(object.getBuffer(),
+                                                                                      object.getBufferIdentifier());
+        if (onCompiled) onCompiled(module->getModuleIdentifier(), object.getBuffer());
+    }
+
+    const llvm::MemoryBuffer *ObjectCache::find(const std::string &identifier) {
+        auto object = objects.find(identifier);
+        if (object != objects.end()) return object->second.get();
+        std::string missing;
+        if (!onMissing || !onMissing(identifier, missing)) return nullptr;
+        store(identifier, missing);
+        return objects[identifier].get();
+    }
+
+    std::unique_ptr<llvm::MemoryBuffer> ObjectCache::getObject(const llvm::Module *module) {
+        const llvm::MemoryBuffer *object = find(module->getModuleIdentifier());
+        if (!object) return nullptr;
+        // The JIT takes ownership of what we return, hand out a copy and keep the original.
+        return llvm::MemoryBuffer::getMemBufferCopy(object->getBuffer(), object->getBufferIdentifier());
+    }
+
+    bool ObjectCache::contains(const std::string &identifier) const {
+        return objects.find(identifier) != objects.end();
+    }
+
+    void ObjectCache::store(const std::string &identifier, llvm::StringRef object) {
+        objects[identifier] = llvm::MemoryBuffer::getMemBufferCopy(object, identifier);
+    }
+
+    void ObjectCache::share(const std::string &identifier, llvm::StringRef data) {
+        store(identifier, data);
+        if (onCompiled) onCompiled(identifier, data);
+    }
+
+    llvm::StringRef ObjectCache::lookup(const std::string &identifier) {
+        const llvm::MemoryBuffer *object = find(identifier);
+        return object ? object->getBuffer() : llvm::StringRef();
+    }
+
+    void ObjectCache::erase(const std::string &identifier) {
+        objects.erase(identifier);
+    }
+
+    void ObjectCache::retainOnly(const std::set<std::string> &identifiers) {
+        for (auto object = objects.begin(); object != objects.end();) {
+            if (identifiers.count(object->first)) ++object;
+            else object = objects.erase(object);
+        }
+    }
+
+    size_t ObjectCache::size() const {
+        return objects.size();
+    }
+}
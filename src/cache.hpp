@@ -0,0 +1,66 @@
+/*
+   Copyright 2019 Atikur Rahman Chitholian
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+#ifndef UCML_CACHE_H
+#define UCML_CACHE_H
+
+#include <map>
+#include <set>
+#include <memory>
+#include <string>
+#include <functional>
+#include <llvm/ExecutionEngine/ObjectCache.h>
+#include <llvm/Support/MemoryBuffer.h>
+
+namespace ucml {
+    /**
+     * In-memory store of compiled object files keyed by module identifier. A module whose identifier is already known
+     * is loaded straight from here by the JIT, without running the optimizer or the code generator again; so the
+     * identifier must name the content of the module (e.g. a fingerprint of its source), not just its symbols.
+     */
+    class ObjectCache : public llvm::ObjectCache {
+        std::map<std::string, std::unique_ptr<llvm::MemoryBuffer> > objects;
+
+        const llvm::MemoryBuffer *find(const std::string &identifier);
+    public:
+        // Called with every object the JIT compiles, e.g. to share it with another process.
+        std::function<void(const std::string &identifier, llvm::StringRef object)> onCompiled;
+        // Asked for whatever is not stored here yet, e.g. by another process; true if it filled in the object.
+        std::function<bool(const std::string &identifier, std::string &object)> onMissing;
+
+        void notifyObjectCompiled(const llvm::Module *module, llvm::MemoryBufferRef object) override;
+
+        std::unique_ptr<llvm::MemoryBuffer> getObject(const llvm::Module *module) override;
+
+        bool contains(const std::string &identifier) const;
+
+        void store(const std::string &identifier, llvm::StringRef object);
+
+        // Stores data of any kind along with the objects (e.g. the IR a cached program prints) and hands it to
+        // onCompiled too.
+        void share(const std::string &identifier, llvm::StringRef data);
+
+        // What is stored under identifier, empty if nothing is.
+        llvm::StringRef lookup(const std::string &identifier);
+
+        void erase(const std::string &identifier);
+
+        void retainOnly(const std::set<std::string> &identifiers);
+
+        size_t size() const;
+    };
+}
+
+#endif
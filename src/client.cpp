@@ -0,0 +1,64 @@
+/*
+   Copyright 2019 Atikur Rahman Chitholian
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <iostream>
+#include <unistd.h>
+#include <sys/un.h>
+#include <sys/socket.h>
+#include "protocol.hpp"
+
+/**
+ * Thin client: hands its command line, working directory and standard streams to a running "uCML --daemon" and
+ * returns the exit status of the command. Without a daemon it runs the compiler itself, so both behave the same.
+ */
+int main(int argc, char *argv[]) {
+    std::string path = ucml::Protocol::socketPath();
+    struct sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+    int daemon = path.empty() ? -1 : socket(AF_UNIX, SOCK_STREAM, 0);
+    if (daemon < 0 || connect(daemon, (struct sockaddr *) &address, sizeof(address))) {
+        argv[0] = (char *) "uCML";
+        execvp(argv[0], argv);
+        std::cerr << "====> Error! No daemon on \"" << path << "\" and cannot run \"uCML\", " << strerror(errno)
+                  << ".\n";
+        return 127;
+    }
+    if (!ucml::Protocol::isSameUser(daemon)) {
+        // Never hand our descriptors, directory and arguments to a socket someone else is listening on.
+        std::cerr << "====> Error! The daemon on \"" << path << "\" runs as another user, refusing to use it.\n";
+        return 1;
+    }
+
+    char directory[4096];
+    if (!getcwd(directory, sizeof(directory))) {
+        std::cerr << "====> Error! Cannot get the working directory, " << strerror(errno) << ".\n";
+        return 1;
+    }
+    std::vector<std::string> strings{directory, "uCML"};
+    for (int i = 1; i < argc; ++i) strings.emplace_back(argv[i]);
+    int32_t status;
+    if (!ucml::Protocol::sendRequest(daemon, strings) ||
+        !ucml::Protocol::readFully(daemon, &status, sizeof(status))) {
+        std::cerr << "====> Error! The daemon on \"" << path << "\" did not complete the request.\n";
+        return 1;
+    }
+    return status;
+}
@@ -14,14 +14,105 @@
    limitations under the License.
 */
 #include "context.hpp"
+#include "tools.hpp"
 #include <llvm/IR/Module.h>
 #include <llvm/IR/LLVMContext.h>
+#include <llvm/IR/GlobalVariable.h>
 #include <iostream>
 namespace ucml {
-    Context::Context(llvm::LLVMContext &context) : llvmContext(context) {
+    Context::Context(llvm::LLVMContext &context) : epoch(0), epochs(0), llvmContext(context), mainFunction(nullptr),
+                                                     incremental(false), linkedLibraries(0), generator(nullptr),
+                                                     loopHints(0),
+                                                     debugBuilder(nullptr), debugUnit(nullptr), debugFile(nullptr) {
         module = new llvm::Module("main", context);
     }
 
+    llvm::GlobalValue::LinkageTypes Context::definitionLinkage() {
+        // Later modules can only link against symbols that are visible outside their own module.
+        return incremental ? llvm::GlobalValue::ExternalLinkage : llvm::GlobalValue::InternalLinkage;
+    }
+
+    llvm::DIType *Context::getDebugType(llvm::Type *type) {
+        if (type->isIntegerTy(1)) {
+            return debugBuilder->createBasicType("bool", 8, llvm::dwarf::DW_ATE_boolean);
+        } else if (type->isIntegerTy()) {
+            return debugBuilder->createBasicType(Tools::nameOf(type), type->getIntegerBitWidth(),
+                                                 llvm::dwarf::DW_ATE_signed);
+        } else if (type->isFloatingPointTy()) {
+            return debugBuilder->createBasicType(Tools::nameOf(type), type->getPrimitiveSizeInBits(),
+                                                 llvm::dwarf::DW_ATE_float);
+        }
+        return nullptr;
+    }
+
+    const std::string &Context::resolveType(const std::string &typeName) const {
+        auto argument = typeArguments.find(typeName);
+        return argument == typeArguments.end() ? typeName : argument->second;
+    }
+
+    std::stack<Scope *> Context::suspendScopes() {
+        std::stack<Scope *> suspended;
+        scopes.swap(suspended);
+        epoch = ++epochs; // Hides the locals of the suspended scopes.
+        createNewScope(); // A fresh global scope, exactly what a top-level function is generated in.
+        return suspended;
+    }
+
+    void Context::resumeScopes(std::stack<Scope *> &suspended) {
+        scopes.swap(suspended);
+        epoch = scopes.empty() ? 0 : scopes.top()->epoch;
+    }
+
+    llvm::Function *Context::getFunction(const std::string &name) {
+        llvm::Function *function = module->getFunction(name);
+        if (function) return function;
+        auto prototype = prototypes.find(name);
+        if (prototype == prototypes.end()) return nullptr;
+        function = llvm::Function::Create(prototype->second, llvm::GlobalValue::ExternalLinkage, name, module);
+        function->setCallingConv(llvm::CallingConv::C);
+        return function;
+    }
+
+    llvm::GlobalVariable *Context::getGlobal(const std::string &name) {
+        llvm::GlobalVariable *variable = module->getNamedGlobal(name);
+        if (variable) return variable;
+        auto global = globals.find(name);
+        if (global == globals.end()) return nullptr;
+        return new llvm::GlobalVariable(*module, global->second, false, llvm::GlobalValue::ExternalLinkage, nullptr,
+                                        name);
+    }
+
+    void Context::declareFunction(const std::string &name, llvm::FunctionType *type) {
+        prototypes[name] = type;
+    }
+
+    void Context::forgetFunction(const std::string &name) {
+        prototypes.erase(name);
+    }
+
+    void Context::commitModule() {
+        for (auto &function : *module) {
+            if (!function.hasLocalLinkage()) prototypes[function.getName().str()] = function.getFunctionType();
+        }
+        for (auto &variable : module->globals()) {
+            if (!variable.hasLocalLinkage()) globals[variable.getName().str()] = variable.getValueType();
+        }
+    }
+
+    void Context::startModule(const std::string &name) {
+        taskVariables.clear(); // Whatever a compile error left unjoined is not worth a warning.
+        while (!scopes.empty()) closeCurrentScope();
+        bindings.clear(); // Including those of scopes a compile error left behind.
+        epoch = 0;
+        module = new llvm::Module(name, llvmContext);
+        mainFunction = nullptr;
+        globalSymbols.clear();
+        tasks.clear();
+        debugBuilder = nullptr;
+        debugUnit = nullptr;
+        debugFile = nullptr;
+    }
+
     llvm::BasicBlock *Context::getCurrentBlock() {
         return scopes.top()->block;
     }
@@ -38,8 +129,24 @@ namespace ucml {
         return scopes.top()->symbols;
     }
 
+    void Context::defineSymbol(const std::string &name, llvm::Type *type, llvm::Value *value) {
+        auto &symbol = scopes.top()->symbols[name];
+        symbol = std::make_pair(type, value);
+        bindings[name].emplace_back(scopes.top(), &symbol);
+    }
+
+    std::pair<llvm::Type *, llvm::Value *> *Context::findSymbol(const std::string &name) {
+        auto found = bindings.find(name);
+        if (found == bindings.end()) return nullptr;
+        for (auto binding = found->second.rbegin(); binding != found->second.rend(); ++binding) {
+            if (binding->first->epoch == epoch) return binding->second;
+        }
+        return nullptr;
+    }
+
     Scope *Context::createNewScope(llvm::BasicBlock *withBlock) {
         auto *scope = new Scope();
+        scope->epoch = epoch;
         scope->parent = scopes.empty() ? nullptr : scopes.top();
         scopes.push(scope);
         if (withBlock) setCurrentBlock(withBlock);
@@ -49,6 +156,25 @@ namespace ucml {
     void Context::closeCurrentScope() {
         if (scopes.empty())
             return;
+        Scope *scope = scopes.top();
+        for (auto &symbol : scope->symbols) {
+            auto task = taskVariables.find(symbol.second.second);
+            if (task != taskVariables.end()) {
+                if (!task->second.joined) {
+                    YYLTYPE location{};
+                    location.first_line = task->second.line;
+                    location.first_column = task->second.column;
+                    W(location, "Task \"" << task->second.name << "\" is never joined, its frame leaks and it may "
+                                                                "still be running when the program ends.");
+                }
+                taskVariables.erase(task);
+            }
+            auto found = bindings.find(symbol.first);
+            if (found == bindings.end()) continue;
+            auto &stack = found->second;
+            if (!stack.empty() && stack.back().first == scope) stack.pop_back();
+            if (stack.empty()) bindings.erase(found);
+        }
         scopes.pop();
     }
 
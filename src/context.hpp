@@ -18,31 +18,120 @@
 
 #include <string>
 #include <map>
+#include <unordered_map>
+#include <set>
 #include <stack>
+#include <vector>
+#include <functional>
 #include <llvm/IR/BasicBlock.h>
 #include <llvm/IR/Value.h>
 #include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/DIBuilder.h>
 
 
 namespace ucml {
+    class FunctionDeclaration;
+
     class Scope {
     public:
         llvm::BasicBlock *block;
         llvm::Value *returnVal;
         std::map<std::string, std::pair<llvm::Type *, llvm::Value *> > symbols;
         Scope *parent;
+        unsigned epoch; // Differs for a function generated in the middle of another, see suspendScopes().
+        bool isLoop;    // The scope of a "for" loop, whose body may run many times.
+    };
+
+    // A coroutine being generated: where "yield" leaves values for the consumer, and the blocks every suspend
+    // point branches to.
+    struct Generator {
+        llvm::Function *function;
+        llvm::Value *id, *handle, *promise;
+        llvm::BasicBlock *finish;  // Final suspend point, reached when the body runs to its end.
+        llvm::BasicBlock *cleanup; // Frees the frame once the consumer destroys the generator.
+        llvm::BasicBlock *suspend; // Returns to whoever started or resumed the generator.
     };
 
     class Context {
         std::stack<Scope *> scopes;
+        // Every local variable in scope by name, innermost last, so finding one costs the same however deeply the
+        // scopes nest. Only bindings of the current epoch are visible.
+        std::unordered_map<std::string, std::vector<std::pair<Scope *, std::pair<llvm::Type *, llvm::Value *> *> > >
+                bindings;
+        unsigned epoch, epochs;
+        // Symbols defined by modules that were already handed over to the JIT (incremental mode only).
+        std::map<std::string, llvm::FunctionType *> prototypes;
+        std::map<std::string, llvm::Type *> globals;
     public:
         llvm::Module *module;
         llvm::LLVMContext &llvmContext;
+        llvm::Function *mainFunction;
+        bool incremental;
+        // Directories searched by "import", bitcode of imported libraries still to be linked and a hook that
+        // (re)builds a library from its source when its precompiled files are missing or stale.
+        std::vector<std::string> importPaths;
+        std::vector<std::string> libraries;
+        size_t linkedLibraries;
+        std::set<std::string> imported;
+        std::function<bool(const std::string &source)> buildLibrary;
+        // Generic functions by name, and the concrete types bound to type parameters while instantiating one.
+        std::map<std::string, FunctionDeclaration *> templates;
+        std::map<std::string, std::string> typeArguments;
+        // Element type of every generator by name, the one being generated and the handles of generators that
+        // "for" loops are currently iterating over (destroyed by a "return" leaving the loop early).
+        std::map<std::string, std::string> generators;
+        Generator *generator;
+        std::vector<llvm::Value *> iterated;
+        // Globals of the current module as Tools::getValueOfIdentifier() hands them out, made once per global.
+        std::unordered_map<std::string, std::pair<llvm::Type *, llvm::Value *>> globalSymbols;
+        // Result type of every task spawned in the current module, by the handle "spawn" returned.
+        std::map<llvm::Value *, llvm::Type *> tasks;
+        // Local "task" variables in scope by their allocation: where they were declared and whether join() was
+        // written for them. One never joined is warned about when its scope closes.
+        struct TaskVariable {
+            Scope *scope;
+            std::string name;
+            int line, column;
+            bool joined;
+        };
+        std::map<llvm::Value *, TaskVariable> taskVariables;
+        // Loops of the current module carrying unroll/vectorize/interleave hints, which only -O1 and up honour.
+        unsigned loopHints;
+        // DWARF debug information, only present when compiling with -g.
+        llvm::DIBuilder *debugBuilder;
+        llvm::DICompileUnit *debugUnit;
+        llvm::DIFile *debugFile;
 
         explicit Context(llvm::LLVMContext &context);
 
+        llvm::GlobalValue::LinkageTypes definitionLinkage();
+
+        llvm::DIType *getDebugType(llvm::Type *type);
+
+        const std::string &resolveType(const std::string &typeName) const;
+
+        std::stack<Scope *> suspendScopes();
+
+        void resumeScopes(std::stack<Scope *> &suspended);
+
+        llvm::Function *getFunction(const std::string &name);
+
+        llvm::GlobalVariable *getGlobal(const std::string &name);
+
+        void declareFunction(const std::string &name, llvm::FunctionType *type);
+
+        void forgetFunction(const std::string &name);
+
+        void commitModule();
+
+        void startModule(const std::string &name);
+
         std::map<std::string, std::pair<llvm::Type *, llvm::Value *> > &getSymbols();
 
+        void defineSymbol(const std::string &name, llvm::Type *type, llvm::Value *value);
+
+        std::pair<llvm::Type *, llvm::Value *> *findSymbol(const std::string &name);
+
         Scope *getCurrentScope();
 
         llvm::BasicBlock *getCurrentBlock();
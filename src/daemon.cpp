@@ -0,0 +1,213 @@
+/*
+   Copyright 2019 Atikur Rahman Chitholian
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <cerrno>
+#include <csignal>
+#include <iostream>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/un.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include "daemon.hpp"
+#include "protocol.hpp"
+#include "tools.hpp"
+
+namespace ucml {
+    static const size_t cacheCapacity = 4096; // Compiled modules kept resident.
+
+    Daemon::Daemon(const std::string &socketPath, unsigned poolSize, Handler handler) :
+            socketPath(socketPath), poolSize(poolSize ? poolSize : 1), handler(std::move(handler)), listener(-1) {}
+
+    int Daemon::run() {
+        signal(SIGPIPE, SIG_IGN); // A client going away must not take the daemon with it.
+        if (socketPath.empty()) {
+            std::cerr << "====> Error! Cannot create a private directory for the socket, set UCML_SOCKET instead.\n";
+            return 1;
+        }
+        struct sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+        if (socketPath.size() >= sizeof(address.sun_path)) {
+            std::cerr << "====> Error! Socket path \"" << socketPath << "\" is too long.\n";
+            return 1;
+        }
+        strcpy(address.sun_path, socketPath.c_str());
+        unlink(socketPath.c_str());
+        listener = socket(AF_UNIX, SOCK_STREAM, 0);
+        mode_t mask = umask(077); // Created 0600: only this user may connect.
+        bool bound = listener >= 0 && !bind(listener, (struct sockaddr *) &address, sizeof(address));
+        umask(mask);
+        if (!bound || listen(listener, 128)) {
+            std::cerr << "====> Error! Cannot listen on \"" << socketPath << "\", " << strerror(errno) << ".\n";
+            return 1;
+        }
+
+        {
+            // Initialize LLVM and detect the host once, every worker inherits the result.
+            llvm::LLVMContext llvmContext;
+            Context context(llvmContext);
+            Options options;
+            options.cpu = "native";
+            Tools::initialize(nullptr, context, options);
+        }
+        std::cout << "====> Listening on \"" << socketPath << "\" with " << poolSize << " idle worker(s).\n";
+        std::cout.flush();
+
+        while (true) {
+            size_t idle = 0;
+            for (auto &worker : workers) idle += !worker.busy;
+            for (; idle < poolSize; ++idle) spawnWorker();
+
+            std::vector<struct pollfd> channels;
+            for (auto &worker : workers) channels.push_back({worker.channel, POLLIN, 0});
+            if (poll(channels.data(), channels.size(), -1) < 0) {
+                if (errno == EINTR) continue;
+                std::cerr << "====> Error! Cannot wait for workers, " << strerror(errno) << ".\n";
+                return 1;
+            }
+            for (size_t i = channels.size(); i-- > 0;) {
+                if (!channels[i].revents || receiveMessage(workers[i])) continue;
+                // The worker finished its request and exited.
+                close(workers[i].channel);
+                waitpid(workers[i].processId, nullptr, 0);
+                workers.erase(workers.begin() + i);
+            }
+        }
+    }
+
+    void Daemon::spawnWorker() {
+        int channel[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, channel)) {
+            std::cerr << "====> Error! Cannot create a worker, " << strerror(errno) << ".\n";
+            exit(1);
+        }
+        std::cout.flush();
+        pid_t processId = fork();
+        if (processId < 0) {
+            std::cerr << "====> Error! Cannot create a worker, " << strerror(errno) << ".\n";
+            exit(1);
+        }
+        if (processId == 0) {
+            close(channel[0]);
+            for (auto &worker : workers) close(worker.channel);
+            serve(channel[1]);
+        }
+        close(channel[1]);
+        workers.push_back({processId, channel[0], false});
+    }
+
+    void Daemon::serve(int channel) {
+        int client;
+        while (true) {
+            do client = accept(listener, nullptr, nullptr); while (client < 0 && errno == EINTR);
+            if (client < 0) _exit(1);
+            if (Protocol::isSameUser(client)) break;
+            std::cerr << "====> Warning! Rejected a client running as another user.\n";
+            close(client);
+        }
+        close(listener);
+        char taken = 'R';
+        Protocol::writeFully(channel, &taken, 1);
+
+        int32_t status = 1;
+        int descriptors[3];
+        std::vector<std::string> strings;
+        if (Protocol::receiveRequest(client, strings, descriptors) && strings.size() >= 2) {
+            for (int i = 0; i < 3; ++i) {
+                dup2(descriptors[i], i);
+                close(descriptors[i]);
+            }
+            if (chdir(strings[0].c_str())) {
+                std::cerr << "====> Error! Cannot enter directory \"" << strings[0] << "\", " << strerror(errno)
+                          << ".\n";
+            } else {
+                cache.onCompiled = [channel](const std::string &identifier, llvm::StringRef object) {
+                    char kind = 'O';
+                    uint32_t identifierSize = (uint32_t) identifier.size();
+                    uint64_t objectSize = object.size();
+                    Protocol::writeFully(channel, &kind, 1);
+                    Protocol::writeFully(channel, &identifierSize, sizeof(identifierSize));
+                    Protocol::writeFully(channel, identifier.data(), identifierSize);
+                    Protocol::writeFully(channel, &objectSize, sizeof(objectSize));
+                    Protocol::writeFully(channel, object.data(), objectSize);
+                };
+                // Workers forked before a program was compiled ask the daemon for it instead of compiling it again.
+                cache.onMissing = [channel](const std::string &identifier, std::string &object) {
+                    char kind = 'Q';
+                    uint32_t identifierSize = (uint32_t) identifier.size();
+                    uint64_t objectSize;
+                    if (!Protocol::writeFully(channel, &kind, 1) ||
+                        !Protocol::writeFully(channel, &identifierSize, sizeof(identifierSize)) ||
+                        !Protocol::writeFully(channel, identifier.data(), identifierSize) ||
+                        !Protocol::readFully(channel, &objectSize, sizeof(objectSize)) || objectSize == UINT64_MAX)
+                        return false;
+                    object.resize(objectSize);
+                    return Protocol::readFully(channel, &object[0], objectSize);
+                };
+                std::vector<char *> arguments;
+                for (size_t i = 1; i < strings.size(); ++i) arguments.push_back(&strings[i][0]);
+                arguments.push_back(nullptr);
+                Tools::recoverErrors = true; // Report compile errors through the exit status, as the compiler would.
+                try {
+                    status = handler((int) arguments.size() - 1, arguments.data(), &cache);
+                } catch (CompileError &) {
+                    status = 1;
+                }
+            }
+        }
+        std::cout.flush();
+        std::cerr.flush();
+        fflush(nullptr);
+        Protocol::writeFully(client, &status, sizeof(status));
+        _exit(0); // Everything else belongs to the daemon, leave it alone.
+    }
+
+    bool Daemon::receiveMessage(Worker &worker) {
+        char kind;
+        if (!Protocol::readFully(worker.channel, &kind, 1)) return false;
+        if (kind == 'R') {
+            worker.busy = true; // Took a request, another worker has to wait in its place.
+            return true;
+        }
+        uint32_t identifierSize;
+        uint64_t objectSize;
+        std::string identifier, object;
+        if (!Protocol::readFully(worker.channel, &identifierSize, sizeof(identifierSize))) return false;
+        identifier.resize(identifierSize);
+        if (!Protocol::readFully(worker.channel, &identifier[0], identifierSize)) return false;
+        if (kind == 'Q') {
+            // The worker waits for the answer: the object and its size, or no object at all.
+            llvm::StringRef found = cache.lookup(identifier);
+            objectSize = cache.contains(identifier) ? found.size() : UINT64_MAX;
+            return Protocol::writeFully(worker.channel, &objectSize, sizeof(objectSize)) &&
+                   (objectSize == UINT64_MAX || Protocol::writeFully(worker.channel, found.data(), found.size()));
+        }
+        if (!Protocol::readFully(worker.channel, &objectSize, sizeof(objectSize))) return false;
+        object.resize(objectSize);
+        if (!Protocol::readFully(worker.channel, &object[0], objectSize)) return false;
+        if (cache.contains(identifier)) return true;
+        cache.store(identifier, object);
+        cached.push_back(identifier);
+        if (cached.size() > cacheCapacity) {
+            cache.erase(cached.front());
+            cached.pop_front();
+        }
+        return true;
+    }
+}
@@ -0,0 +1,67 @@
+/*
+   Copyright 2019 Atikur Rahman Chitholian
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+#ifndef UCML_DAEMON_H
+#define UCML_DAEMON_H
+
+#include <deque>
+#include <string>
+#include <vector>
+#include <functional>
+#include "cache.hpp"
+
+namespace ucml {
+    /**
+     * Resident compiler listening on a Unix domain socket (see Protocol). LLVM is initialized once, then a pool of
+     * forked workers waits on the socket; each one serves a single request (the same command line the compiler
+     * accepts) with the client's working directory and standard streams, then exits and is replaced. Workers are
+     * forked from the warm daemon, so none of them pays for process start-up or LLVM initialization, and a crash or
+     * a runaway program only ever takes down its own worker.
+     *
+     * Every object a worker compiles is sent back to the daemon and kept, keyed by a hash of the program's source,
+     * options and imported libraries. A worker missing an object asks the daemon for it before compiling, so any
+     * later run of the same program (or precompiled module) skips straight to running, whenever its worker was
+     * forked.
+     */
+    class Daemon {
+    public:
+        typedef std::function<int(int argc, char *argv[], ObjectCache *cache)> Handler;
+    private:
+        std::string socketPath;
+        unsigned poolSize;
+        Handler handler;
+        ObjectCache cache;
+        std::deque<std::string> cached; // Identifiers in the cache, oldest first.
+        struct Worker {
+            int processId;
+            int channel; // Reports taken requests and compiled objects to the daemon, asks it for cached ones.
+            bool busy;
+        };
+        std::vector<Worker> workers;
+        int listener;
+
+        void spawnWorker();
+
+        [[noreturn]] void serve(int channel);
+
+        bool receiveMessage(Worker &worker);
+    public:
+        Daemon(const std::string &socketPath, unsigned poolSize, Handler handler);
+
+        int run();
+    };
+}
+
+#endif
@@ -0,0 +1,214 @@
+/*
+   Copyright 2019 Atikur Rahman Chitholian
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "input.hpp"
+
+namespace {
+    struct Stream {
+        const char *data{nullptr};
+        size_t size{0}, position{0};
+        int descriptor{-1};       // Still to be read from, in chunks, when the input could not be mapped.
+        bool mapped{false};
+        std::vector<char> buffer; // Chunks read so far, from "position" on.
+    };
+
+    const size_t chunkSize = 1 << 20, longestNumber = 64;
+    std::vector<Stream> streams(1);
+    bool hasStandardInput = false;
+
+    bool setUp(Stream &stream, int descriptor) {
+        struct stat status{};
+        if (fstat(descriptor, &status) == 0 && S_ISREG(status.st_mode)) {
+            stream.size = (size_t) status.st_size;
+            if (!stream.size) return true;
+            void *mapping = mmap(nullptr, stream.size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+            if (mapping != MAP_FAILED) {
+                madvise(mapping, stream.size, MADV_WILLNEED);
+                stream.data = (const char *) mapping;
+                stream.mapped = true;
+                return true;
+            }
+            stream.size = 0;
+        }
+        stream.descriptor = descriptor;
+        return true;
+    }
+
+    Stream &streamAt(int64_t index) {
+        if (index == 0 && !hasStandardInput) {
+            hasStandardInput = true;
+            setUp(streams[0], STDIN_FILENO);
+        }
+        if (index < 0 || (size_t) index >= streams.size()) {
+            fprintf(stderr, "====> Error! There is no input stream %lld, give files with --input=<file>.\n",
+                    (long long) index);
+            exit(5);
+        }
+        return streams[index];
+    }
+
+    // Makes at least "wanted" unread bytes available, unless the input ends before; tells whether it did.
+    bool fill(Stream &stream, size_t wanted) {
+        while (stream.size - stream.position < wanted && stream.descriptor >= 0) {
+            if (stream.position) {
+                std::memmove(stream.buffer.data(), stream.buffer.data() + stream.position,
+                             stream.size - stream.position);
+                stream.size -= stream.position;
+                stream.position = 0;
+            }
+            if (stream.buffer.size() < stream.size + chunkSize) stream.buffer.resize(stream.size + chunkSize);
+            ssize_t count = read(stream.descriptor, stream.buffer.data() + stream.size,
+                                 stream.buffer.size() - stream.size);
+            if (count < 0 && errno == EINTR) continue;
+            if (count <= 0) stream.descriptor = -1;
+            else stream.size += (size_t) count;
+            stream.data = stream.buffer.data();
+        }
+        return stream.size - stream.position >= wanted;
+    }
+
+    inline bool isDigit(char c) {
+        return c >= '0' && c <= '9';
+    }
+
+    // Moves to the start of the next number; false when there is none.
+    bool skipSeparators(Stream &stream) {
+        while (true) {
+            if (stream.position == stream.size && !fill(stream, 1)) return false;
+            char c = stream.data[stream.position];
+            if (isDigit(c) || c == '-' || c == '+' || c == '.') {
+                fill(stream, longestNumber);
+                // A sign or a point only starts a number when a digit follows.
+                const char *next = stream.data + stream.position + 1, *end = stream.data + stream.size;
+                if (isDigit(c) || (next < end && (isDigit(*next) || (*next == '.' && c != '.' && next + 1 < end &&
+                                                                      isDigit(next[1]))))) {
+                    return true;
+                }
+            }
+            ++stream.position;
+        }
+    }
+
+    const double powersOfTen[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14,
+                                  1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+}
+
+namespace ucml {
+    bool Input::open(const std::vector<std::string> &files) {
+        for (auto &stream : streams) {
+            if (stream.mapped) munmap((void *) stream.data, stream.size);
+        }
+        streams.assign(1, Stream());
+        hasStandardInput = false;
+        for (auto &file : files) {
+            int descriptor = ::open(file.c_str(), O_RDONLY);
+            streams.emplace_back();
+            if (descriptor < 0 || !setUp(streams.back(), descriptor)) {
+                fprintf(stderr, "====> Error! Cannot open input file \"%s\", %s.\n", file.c_str(), strerror(errno));
+                return false;
+            }
+            // The mapping stays valid without the descriptor; a descriptor still being read from stays open.
+            if (streams.back().mapped) close(descriptor);
+        }
+        return true;
+    }
+
+    bool Input::isBuiltIn(const std::string &name) {
+        return name == "readint" || name == "readdouble" || name == "ended" || name == "rows" || name == "intat" ||
+               name == "doubleat";
+    }
+}
+
+int64_t ucml_read_int(int64_t index) {
+    Stream &stream = streamAt(index);
+    if (!skipSeparators(stream)) return 0;
+    const char *p = stream.data + stream.position, *end = stream.data + stream.size;
+    bool negative = *p == '-';
+    if (*p == '-' || *p == '+') ++p;
+    uint64_t value = 0;
+    while (p < end && isDigit(*p)) value = value * 10 + (uint64_t) (*p++ - '0');
+    // Whatever fraction or exponent follows is not part of an integer.
+    while (p < end && (isDigit(*p) || *p == '.' || *p == 'e' || *p == 'E')) ++p;
+    stream.position = (size_t) (p - stream.data);
+    return negative ? -(int64_t) value : (int64_t) value;
+}
+
+double ucml_read_double(int64_t index) {
+    Stream &stream = streamAt(index);
+    if (!skipSeparators(stream)) return 0;
+    const char *start = stream.data + stream.position, *p = start, *end = stream.data + stream.size;
+    bool negative = *p == '-';
+    if (*p == '-' || *p == '+') ++p;
+    uint64_t mantissa = 0;
+    int digits = 0, exponent = 0;
+    for (; p < end && isDigit(*p); ++p, ++digits) mantissa = mantissa * 10 + (uint64_t) (*p - '0');
+    if (p < end && *p == '.') {
+        for (++p; p < end && isDigit(*p); ++p, ++digits, --exponent) mantissa = mantissa * 10 + (uint64_t) (*p - '0');
+    }
+    if (p + 1 < end && (*p == 'e' || *p == 'E') &&
+        (isDigit(p[1]) || ((p[1] == '-' || p[1] == '+') && p + 2 < end && isDigit(p[2])))) {
+        const char *q = p + 1;
+        bool negativeExponent = *q == '-';
+        if (*q == '-' || *q == '+') ++q;
+        int value = 0;
+        for (; q < end && isDigit(*q); ++q) value = value < 100000 ? value * 10 + (*q - '0') : value;
+        exponent += negativeExponent ? -value : value;
+        p = q;
+    }
+    stream.position = (size_t) (p - stream.data);
+    // Exact when both the digits and the power of ten fit a double (Clinger's fast path), otherwise libc decides.
+    if (digits <= 15 && exponent >= -22 && exponent <= 22) {
+        double value = (double) mantissa;
+        value = exponent < 0 ? value / powersOfTen[-exponent] : value * powersOfTen[exponent];
+        return negative ? -value : value;
+    }
+    char text[longestNumber + 1];
+    size_t length = std::min((size_t) (p - start), longestNumber);
+    std::memcpy(text, start, length);
+    text[length] = '\0';
+    return strtod(text, nullptr);
+}
+
+int64_t ucml_input_ended(int64_t index) {
+    return !skipSeparators(streamAt(index));
+}
+
+const char *ucml_input_data(int64_t index) {
+    Stream &stream = streamAt(index);
+    // A pipe has to be read to its end first, a mapped file is already there.
+    while (stream.descriptor >= 0) fill(stream, stream.size - stream.position + chunkSize);
+    return stream.data + stream.position;
+}
+
+int64_t ucml_input_rows(int64_t index) {
+    ucml_input_data(index);
+    Stream &stream = streamAt(index);
+    return (int64_t) ((stream.size - stream.position) / 8);
+}
+
+void ucml_input_out_of_range(int64_t index, int64_t row) {
+    fprintf(stderr, "====> Error! Row %lld is past the end of input stream %lld (%lld rows).\n", (long long) row,
+            (long long) index, (long long) ucml_input_rows(index));
+    exit(5);
+}
@@ -0,0 +1,53 @@
+/*
+   Copyright 2019 Atikur Rahman Chitholian
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+#ifndef UCML_INPUT_H
+#define UCML_INPUT_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace ucml {
+    /**
+     * Numbers read by uCML programs while they run. Stream 0 is stdin, stream n the n-th "--input=<file>".
+     *
+     *     text     readint(stream), readdouble(stream) and ended(stream): numbers separated by anything that is not
+     *              part of a number (spaces, newlines, commas, ...), parsed straight out of the input
+     *     binary   rows(stream), intat(stream, row) and doubleat(stream, row): the input as a column of raw 64-bit
+     *              values, read in place; a row past the end stops the program
+     *
+     * Files, and stdin when redirected from one, are memory-mapped; a piped stdin is read in large chunks. Text
+     * streams keep a single read position, so reading them from several threads at once is not supported.
+     */
+    class Input {
+    public:
+        static bool open(const std::vector<std::string> &files);
+
+        static bool isBuiltIn(const std::string &name);
+    };
+}
+
+// What the builtins compile to.
+extern "C" {
+int64_t ucml_read_int(int64_t stream);
+double ucml_read_double(int64_t stream);
+int64_t ucml_input_ended(int64_t stream);
+int64_t ucml_input_rows(int64_t stream);
+const char *ucml_input_data(int64_t stream);
+void ucml_input_out_of_range(int64_t stream, int64_t row);
+}
+
+#endif
@@ -0,0 +1,148 @@
+/*
+   Copyright 2019 Atikur Rahman Chitholian
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+#include <cstdint>
+#include <iostream>
+#include <llvm/IR/Function.h>
+#include <llvm/IRReader/IRReader.h>
+#include <llvm/Linker/Linker.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/SourceMgr.h>
+#include <llvm/Transforms/IPO/Internalize.h>
+#include "intrinsics.hpp"
+#include "input.hpp"
+#include "tasks.hpp"
+
+// Built-in helpers, every one both as native code and as IR computing exactly the same.
+extern "C" {
+double ucml_clamp(double x, double low, double high) {
+    double below = x < low ? low : x;
+    return below > high ? high : below;
+}
+
+int64_t ucml_hash(int64_t x) { // The finalizer of splitmix64.
+    auto z = (uint64_t) x;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return (int64_t) (z ^ (z >> 31));
+}
+}
+
+static const char *clampCode = R"(
+define double @clamp(double %x, double %low, double %high) {
+  %isBelow = fcmp olt double %x, %low
+  %below = select i1 %isBelow, double %low, double %x
+  %isAbove = fcmp ogt double %below, %high
+  %result = select i1 %isAbove, double %high, double %below
+  ret double %result
+}
+)";
+
+static const char *hashCode = R"(
+define i64 @hash(i64 %x) {
+  %1 = lshr i64 %x, 30
+  %2 = xor i64 %x, %1
+  %3 = mul i64 %2, -4658895280553007687
+  %4 = lshr i64 %3, 27
+  %5 = xor i64 %3, %4
+  %6 = mul i64 %5, -7723592293110705685
+  %7 = lshr i64 %6, 31
+  %8 = xor i64 %6, %7
+  ret i64 %8
+}
+)";
+
+namespace ucml {
+    std::map<std::string, void *> &Intrinsics::natives() {
+        static std::map<std::string, void *> natives;
+        return natives;
+    }
+
+    std::map<std::string, std::string> &Intrinsics::bodies() {
+        static std::map<std::string, std::string> bodies;
+        return bodies;
+    }
+
+    void Intrinsics::addNative(const std::string &name, void *address) {
+        natives()[name] = address;
+    }
+
+    void Intrinsics::addBitcode(const std::string &name, const std::string &code) {
+        bodies()[name] = code;
+    }
+
+    void Intrinsics::addBuiltIns() {
+        // "clamp" and "hash" inline, their "_native" twins are the same code behind a call (see benchmarks/).
+        addBitcode("clamp", clampCode);
+        addBitcode("hash", hashCode);
+        addNative("clamp_native", (void *) &ucml_clamp);
+        addNative("hash_native", (void *) &ucml_hash);
+        // What readint(), readdouble(), ended(), rows(), intat() and doubleat() call.
+        addNative("ucml_read_int", (void *) &ucml_read_int);
+        addNative("ucml_read_double", (void *) &ucml_read_double);
+        addNative("ucml_input_ended", (void *) &ucml_input_ended);
+        addNative("ucml_input_rows", (void *) &ucml_input_rows);
+        addNative("ucml_input_data", (void *) &ucml_input_data);
+        addNative("ucml_input_out_of_range", (void *) &ucml_input_out_of_range);
+        addNative("ucml_task_create", (void *) &ucml_task_create);
+        addNative("ucml_task_start", (void *) &ucml_task_start);
+        addNative("ucml_task_join", (void *) &ucml_task_join);
+        addNative("ucml_task_free", (void *) &ucml_task_free);
+    }
+
+    bool Intrinsics::link(llvm::Module &module) {
+        std::vector<std::string> wanted;
+        for (auto &function : module) {
+            if (function.isDeclaration() && bodies().count(function.getName().str()))
+                wanted.push_back(function.getName().str());
+        }
+        for (auto &name : wanted) {
+            llvm::FunctionType *declared = module.getFunction(name)->getFunctionType();
+            llvm::SMDiagnostic diagnostic;
+            std::unique_ptr<llvm::Module> helper = llvm::parseIR(
+                    llvm::MemoryBufferRef(bodies()[name], name), diagnostic, module.getContext());
+            llvm::Function *body = helper ? helper->getFunction(name) : nullptr;
+            if (!body || body->isDeclaration()) {
+                std::cerr << "====> Error! Cannot load intrinsic \"" << name << "\", "
+                          << (helper ? "it defines no such function" : diagnostic.getMessage().str()) << ".\n";
+                return false;
+            }
+            if (body->getFunctionType() != declared) {
+                std::cerr << "====> Error! The extern declaration of intrinsic \"" << name
+                          << "\" does not match its parameter and return types.\n";
+                return false;
+            }
+            helper->setDataLayout(module.getDataLayout());
+            helper->setTargetTriple(module.getTargetTriple());
+            bool failed = llvm::Linker::linkModules(
+                    module, std::move(helper), llvm::Linker::Flags::LinkOnlyNeeded,
+                    [](llvm::Module &linked, const llvm::StringSet<> &helperSymbols) {
+                        // A private copy per module, free to be inlined and dropped.
+                        llvm::internalizeModule(linked, [&helperSymbols](const llvm::GlobalValue &value) {
+                            return !value.hasName() || !helperSymbols.count(value.getName());
+                        });
+                    });
+            if (failed) {
+                std::cerr << "====> Error! Cannot link intrinsic \"" << name << "\".\n";
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void Intrinsics::bind(llvm::ExecutionEngine &engine) {
+        for (auto &native : natives()) engine.addGlobalMapping(native.first, (uint64_t) (uintptr_t) native.second);
+    }
+}
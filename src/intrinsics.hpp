@@ -0,0 +1,54 @@
+/*
+   Copyright 2019 Atikur Rahman Chitholian
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+#ifndef UCML_INTRINSICS_H
+#define UCML_INTRINSICS_H
+
+#include <map>
+#include <string>
+#include <llvm/IR/Module.h>
+#include <llvm/ExecutionEngine/ExecutionEngine.h>
+
+namespace ucml {
+    /**
+     * Helpers the host offers to uCML code, which declares them with "extern" like any C function:
+     *
+     *     native   bound straight to the address the host registered, no search through the dynamic symbol table;
+     *              still an opaque call
+     *     bitcode  an LLVM module (bitcode or textual IR) defining the helper, linked privately into every module
+     *              calling it, so the optimizer inlines it into the caller's loops like uCML code
+     *
+     * Externs without a registered helper keep being resolved through the dynamic symbol table.
+     */
+    class Intrinsics {
+        static std::map<std::string, void *> &natives();
+
+        static std::map<std::string, std::string> &bodies();
+
+    public:
+        static void addNative(const std::string &name, void *address);
+
+        static void addBitcode(const std::string &name, const std::string &code);
+
+        // The helpers uCML itself offers, see intrinsics.cpp.
+        static void addBuiltIns();
+
+        static bool link(llvm::Module &module);
+
+        static void bind(llvm::ExecutionEngine &engine);
+    };
+}
+
+#endif
@@ -0,0 +1,249 @@
+/*
+   Copyright 2019 Atikur Rahman Chitholian
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+#include <fstream>
+#include <regex>
+#include <set>
+#include <sstream>
+#include <iostream>
+#include <llvm/IR/Constants.h>
+#include <llvm/IR/GlobalVariable.h>
+#include <llvm/IR/Instructions.h>
+#include <llvm/Bitcode/BitcodeWriter.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/Path.h>
+#include "library.hpp"
+
+namespace ucml {
+    static bool isOlder(const std::string &file, const std::string &than) {
+        llvm::sys::fs::file_status fileStatus, thanStatus;
+        if (llvm::sys::fs::status(file, fileStatus) || llvm::sys::fs::status(than, thanStatus)) return true;
+        return fileStatus.getLastModificationTime() < thanStatus.getLastModificationTime();
+    }
+
+    std::string Library::initializerOf(const std::string &name) {
+        return "__init_" + name;
+    }
+
+    bool Library::build(const std::string &sourceFile, const Options &options, llvm::LLVMContext &llvmContext) {
+        // Importing a stale library builds it, and it may import the one being built: that never ends.
+        static std::set<std::string> building;
+        llvm::SmallString<256> path;
+        if (llvm::sys::fs::real_path(sourceFile, path)) path = sourceFile;
+        if (!building.insert(path.str().str()).second) {
+            E("====> Error! Import cycle through library \"" << sourceFile << "\".");
+            return false;
+        }
+        struct Built {
+            std::string path;
+
+            ~Built() { building.erase(path); }
+        } built{path.str().str()};
+
+        std::ifstream file(sourceFile);
+        if (!file) {
+            E("====> Error! Cannot open library \"" << sourceFile << "\".");
+            return false;
+        }
+        std::stringstream source;
+        source << file.rdbuf();
+        std::cout << "====> Building library \"" << sourceFile << "\"...\n";
+        Block *block = Tools::parseSource(source.str());
+        if (!block) {
+            E("====> Error! Syntax error in library \"" << sourceFile << "\".");
+            return false;
+        }
+        std::string base = sourceFile.substr(0, sourceFile.size() - llvm::sys::path::extension(sourceFile).size()),
+                name = llvm::sys::path::filename(base).str();
+
+        Context context(llvmContext);
+        context.importPaths.push_back(llvm::sys::path::parent_path(sourceFile).str());
+        if (context.importPaths.back().empty()) context.importPaths.back() = ".";
+        context.importPaths.insert(context.importPaths.end(), options.importPaths.begin(), options.importPaths.end());
+        Options libraryOptions = options;
+        libraryOptions.sourceFile = sourceFile;
+        Tools tools = Tools::initialize(block, context, libraryOptions);
+        tools.createBuiltInFunctions(); // Every library carries a private copy of the built-ins.
+        context.incremental = true;     // Everything defined from here on is exported.
+        llvm::Function *initializer = tools.generateCode(initializerOf(name));
+
+        // A library may be imported by several others, make sure its top-level code runs only once.
+        llvm::BasicBlock *body = &initializer->getEntryBlock(),
+                *guard = llvm::BasicBlock::Create(llvmContext, "guard", initializer, body),
+                *first = llvm::BasicBlock::Create(llvmContext, "first", initializer, body),
+                *again = llvm::BasicBlock::Create(llvmContext, "again", initializer);
+        auto *done = new llvm::GlobalVariable(*context.module, llvm::Type::getInt1Ty(llvmContext), false,
+                                             llvm::GlobalValue::InternalLinkage,
+                                             llvm::ConstantInt::getFalse(llvmContext), "__initialized");
+        llvm::IRBuilder<> builder(guard);
+        builder.CreateCondBr(builder.CreateLoad(done), again, first);
+        builder.SetInsertPoint(first);
+        builder.CreateStore(builder.getTrue(), done);
+        builder.CreateBr(body);
+        builder.SetInsertPoint(again);
+        builder.CreateRet(builder.getInt64(0));
+        tools.createBatchFunctions();
+        tools.optimize(initializer);
+
+        std::error_code errorCode;
+        llvm::raw_fd_ostream bitcode(base + ".bc", errorCode, llvm::sys::fs::OpenFlags::F_None);
+        if (errorCode.value()) {
+            E("====> Error! Cannot write to file \"" << base << ".bc\", " << errorCode.message());
+            return false;
+        }
+        llvm::WriteBitcodeToFile(*context.module, bitcode);
+        bitcode.flush();
+
+        std::ofstream interface(base + ".mli");
+        interface << "ucml-interface 1\ntarget " << tools.targetIdentity() << "\n";
+        for (auto &library : context.imported) interface << "import " << library << "\n";
+        for (auto &variable : context.module->globals()) {
+            if (variable.hasLocalLinkage() || variable.isDeclaration()) continue;
+            interface << "var " << variable.getName().str() << " " << Tools::nameOf(variable.getValueType()) << "\n";
+        }
+        for (auto &function : *context.module) {
+            if (function.hasLocalLinkage() || function.isDeclaration() || &function == initializer ||
+                Tools::isBatchFunction(function) || function.hasFnAttribute("ucml-generator"))
+                continue;
+            interface << "def " << function.getName().str() << " " << Tools::nameOf(function.getReturnType());
+            for (auto &argument : function.args()) interface << " " << Tools::nameOf(argument.getType());
+            interface << "\n";
+        }
+        if (!interface) {
+            E("====> Error! Cannot write to file \"" << base << ".mli\".");
+            return false;
+        }
+        std::cout << "====> Library written to \"" << base << ".bc\" and \"" << base << ".mli\".\n";
+        return true;
+    }
+
+    bool Library::import(Context &context, const std::string &name, bool callInitializer, std::string &error) {
+        if (context.imported.count(name)) return true;
+        std::string base;
+        for (auto &directory : context.importPaths) {
+            std::string candidate = directory + "/" + name;
+            if (llvm::sys::fs::exists(candidate + ".ml") || llvm::sys::fs::exists(candidate + ".mli")) {
+                base = candidate;
+                break;
+            }
+        }
+        if (base.empty()) {
+            error = "Cannot find library \"" + name + "\"";
+            return false;
+        }
+
+        std::string target;
+        auto *flag = llvm::dyn_cast_or_null<llvm::MDString>(context.module->getModuleFlag("ucml.target"));
+        if (flag) target = "target " + flag->getString().str();
+        std::vector<std::string> lines;
+        for (int attempt = 0; attempt < 2; ++attempt) {
+            bool stale = !llvm::sys::fs::exists(base + ".mli") || !llvm::sys::fs::exists(base + ".bc") ||
+                         (llvm::sys::fs::exists(base + ".ml") && isOlder(base + ".mli", base + ".ml"));
+            lines.clear();
+            std::ifstream interface(base + ".mli");
+            for (std::string line; std::getline(interface, line);) lines.push_back(line);
+            stale = stale || lines.size() < 2 || lines[0] != "ucml-interface 1" || (flag && lines[1] != target);
+            if (!stale) break;
+            if (attempt || !llvm::sys::fs::exists(base + ".ml")) {
+                error = "Library \"" + name + "\" is missing, corrupt or compiled for another target";
+                return false;
+            }
+            if (!context.buildLibrary || !context.buildLibrary(base + ".ml")) {
+                error = "Cannot build library \"" + name + "\"";
+                return false;
+            }
+        }
+
+        context.imported.insert(name);
+        llvm::Function *initializer = context.getFunction(initializerOf(name));
+        if (!initializer) {
+            initializer = llvm::Function::Create(
+                    llvm::FunctionType::get(llvm::Type::getInt64Ty(context.llvmContext), false),
+                    llvm::GlobalValue::ExternalLinkage, initializerOf(name), context.module);
+        }
+        for (size_t i = 2; i < lines.size(); ++i) {
+            std::istringstream line(lines[i]);
+            std::string kind, symbol, typeName;
+            line >> kind >> symbol >> typeName;
+            if (kind == "import") {
+                // Its initializer is already called by the initializer of this library.
+                if (!import(context, symbol, false, error)) return false;
+                continue;
+            }
+            llvm::Type *type = Tools::typeOf(typeName, context.llvmContext);
+            if (!type || symbol.empty()) {
+                error = "Corrupt interface of library \"" + name + "\"";
+                return false;
+            }
+            if (context.module->getNamedValue(symbol) || context.getFunction(symbol) || context.getGlobal(symbol)) {
+                error = "Library \"" + name + "\" redefines \"" + symbol + "\"";
+                return false;
+            }
+            if (kind == "var") {
+                new llvm::GlobalVariable(*context.module, type, false, llvm::GlobalValue::ExternalLinkage, nullptr,
+                                         symbol);
+            } else if (kind == "def") {
+                std::vector<llvm::Type *> argTypes;
+                while (line >> typeName) {
+                    argTypes.push_back(Tools::typeOf(typeName, context.llvmContext));
+                    if (!argTypes.back()) {
+                        error = "Corrupt interface of library \"" + name + "\"";
+                        return false;
+                    }
+                }
+                llvm::Function::Create(llvm::FunctionType::get(type, argTypes, false),
+                                       llvm::GlobalValue::ExternalLinkage, symbol, context.module)
+                        ->setCallingConv(llvm::CallingConv::C);
+            }
+        }
+        context.libraries.push_back(base + ".bc");
+        if (callInitializer) llvm::IRBuilder<>(context.getCurrentBlock()).CreateCall(initializer);
+        return true;
+    }
+
+    std::string Library::importedSources(const std::string &source, const std::vector<std::string> &importPaths) {
+        // A plain scan, an import inside a comment only makes the result a little more specific than needed.
+        static const std::regex import("\\bimport\\s+([A-Za-z_][A-Za-z0-9_]*)");
+        std::vector<std::string> pending;
+        auto scan = [&pending](const std::string &text) {
+            for (std::sregex_iterator match(text.begin(), text.end(), import), end; match != end; ++match)
+                pending.push_back((*match)[1].str());
+        };
+        scan(source);
+        std::set<std::string> seen;
+        std::string sources;
+        while (!pending.empty()) {
+            std::string name = pending.back();
+            pending.pop_back();
+            if (!seen.insert(name).second) continue;
+            sources += "\nimport " + name;
+            for (auto &directory : importPaths) {
+                std::string base = directory + "/" + name;
+                if (!llvm::sys::fs::exists(base + ".ml") && !llvm::sys::fs::exists(base + ".mli")) continue;
+                for (const char *extension : {".ml", ".mli", ".bc"}) {
+                    sources += std::string("\n") + extension + "\n";
+                    auto contents = llvm::MemoryBuffer::getFile(base + extension);
+                    if (!contents) continue;
+                    sources += (*contents)->getBuffer().str();
+                    // Imports of imports.
+                    if (llvm::StringRef(extension) != ".bc") scan((*contents)->getBuffer().str());
+                }
+                break;
+            }
+        }
+        return sources;
+    }
+}
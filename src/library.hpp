@@ -0,0 +1,50 @@
+/*
+   Copyright 2019 Atikur Rahman Chitholian
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+#ifndef UCML_LIBRARY_H
+#define UCML_LIBRARY_H
+
+#include <string>
+#include <vector>
+#include "tools.hpp"
+
+namespace ucml {
+    /**
+     * Separately compiled uCML libraries. Building "name.ml" produces "name.bc" (the optimized code) and "name.mli",
+     * a small text interface listing the exported functions and global variables with their types:
+     *
+     *     ucml-interface 1
+     *     target <triple;cpu;features>
+     *     import <library>
+     *     var <name> <type>
+     *     def <name> <return-type> [<parameter-type> ...]
+     *
+     * Importers only read the interface; the bitcode is linked in by Tools::linkLibraries().
+     */
+    class Library {
+    public:
+        static bool build(const std::string &sourceFile, const Options &options, llvm::LLVMContext &llvmContext);
+
+        static bool import(Context &context, const std::string &name, bool callInitializer, std::string &error);
+
+        static std::string initializerOf(const std::string &name);
+
+        // Sources, interfaces and bitcode of every library a program imports, directly or not, so the program can
+        // be identified by its source plus these.
+        static std::string importedSources(const std::string &source, const std::vector<std::string> &importPaths);
+    };
+}
+
+#endif
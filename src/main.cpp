@@ -14,9 +14,26 @@
    limitations under the License.
 */
 #include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <thread>
+#include <fstream>
+#include <sstream>
+#include <exception>
 #include <llvm/Support/raw_ostream.h>
 #include <llvm/Support/FileSystem.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Support/Threading.h>
 #include "tools.hpp"
+#include "repl.hpp"
+#include "watch.hpp"
+#include "library.hpp"
+#include "daemon.hpp"
+#include "protocol.hpp"
+#include "intrinsics.hpp"
+#include "input.hpp"
+#include "tasks.hpp"
 
 ucml::Block *mainBlock;
 
@@ -26,55 +43,239 @@ extern int yyparse();
 
 void showUsage(char *name);
 
+int runCommand(int argc, char *argv[], ucml::ObjectCache *cache);
+
+int runCached(const std::string &key, llvm::StringRef ir, const std::vector<char *> &files,
+              const ucml::Options &options, ucml::ObjectCache *cache, char *name);
+
+int dumpIR(llvm::StringRef ir, const std::vector<char *> &files, char *name);
+
+int runOnLargeStack(int argc, char *argv[], ucml::ObjectCache *cache);
+
 int main(int argc, char *argv[]) {
-    if (argc < 2) {
-        std::cerr << "====> Error! Input file not provided.\n";
-        showUsage(argv[0]);
-        return 1;
+    ucml::Intrinsics::addBuiltIns();
+    if (argc == 2 && !strcmp(argv[1], "--daemon")) {
+        return ucml::Daemon(ucml::Protocol::socketPath(), std::thread::hardware_concurrency(), runOnLargeStack).run();
     }
-    if (argc > 1) {
-        yyin = fopen(argv[1], "r");
+    return runOnLargeStack(argc, argv, nullptr);
+}
+
+struct Command {
+    int argc;
+    char **argv;
+    ucml::ObjectCache *cache;
+    int status;
+    std::exception_ptr error; // CompileError under Tools::recoverErrors, rethrown to the caller.
+};
+
+int runOnLargeStack(int argc, char *argv[], ucml::ObjectCache *cache) {
+    // Code generation recurses once per nesting level of the source (up to YYMAXDEPTH of them), and so may the
+    // program itself; give both the stack of the threads running tasks and --threads runs rather than 8 MiB.
+    Command command{argc, argv, cache, 0, nullptr};
+    llvm::llvm_execute_on_thread([](void *data) {
+        auto *command = static_cast<Command *>(data);
+        try {
+            command->status = runCommand(command->argc, command->argv, command->cache);
+        } catch (...) {
+            command->error = std::current_exception();
+        }
+    }, &command, ucml::Scheduler::stackSize);
+    if (command.error) std::rethrow_exception(command.error);
+    return command.status;
+}
+
+int runCommand(int argc, char *argv[], ucml::ObjectCache *cache) {
+    ucml::Options options;
+    std::string objectFile, bitcodeFile;
+    bool watch = false, library = false;
+    std::vector<char *> files;
+    std::vector<std::string> inputs;
+    for (int i = 1; i < argc; ++i) {
+        if (!strncmp(argv[i], "-mcpu=", 6)) options.cpu = argv[i] + 6;
+        else if (!strncmp(argv[i], "-mattr=", 7)) options.features = argv[i] + 7;
+        else if (!strncmp(argv[i], "--emit-obj=", 11)) objectFile = argv[i] + 11;
+        else if (!strncmp(argv[i], "--emit-bc=", 10)) bitcodeFile = argv[i] + 10;
+        else if (!strncmp(argv[i], "--input=", 8) && argv[i][8]) inputs.push_back(argv[i] + 8);
+        else if (!strcmp(argv[i], "--watch")) watch = true;
+        else if (!strcmp(argv[i], "--tiered")) options.tierUpAfter = 1000;
+        else if (!strncmp(argv[i], "--tiered=", 9) && atoi(argv[i] + 9) > 0)
+            options.tierUpAfter = (unsigned) atoi(argv[i] + 9);
+        else if (!strcmp(argv[i], "--emit-lib")) library = true;
+        else if (!strcmp(argv[i], "-g")) options.debugInfo = true;
+        else if (!strncmp(argv[i], "--threads=", 10) && atoi(argv[i] + 10) > 0)
+            options.threads = (unsigned) atoi(argv[i] + 10);
+        else if (!strncmp(argv[i], "--workers=", 10) && atoi(argv[i] + 10) > 0)
+            ucml::Scheduler::setWorkers((unsigned) atoi(argv[i] + 10));
+        else if (!strncmp(argv[i], "-I", 2) && argv[i][2]) options.importPaths.push_back(argv[i] + 2);
+        else if (!strncmp(argv[i], "-O", 2) && argv[i][2] >= '0' && argv[i][2] <= '3' && !argv[i][3])
+            options.optLevel = (unsigned) (argv[i][2] - '0');
+        else if (argv[i][0] == '-' && argv[i][1]) {
+            std::cerr << "====> Error! Unknown option \"" << argv[i] << "\".\n";
+            showUsage(argv[0]);
+            return 1;
+        } else files.push_back(argv[i]);
+    }
+    // JIT'd code only ever runs here, so tune it for this very machine unless told otherwise.
+    if (options.cpu.empty() && objectFile.empty()) options.cpu = "native";
+    if (options.tierUpAfter && (!objectFile.empty() || !bitcodeFile.empty() || options.threads || library || watch))
+        options.tierUpAfter = 0; // Tiers only apply to a single run of the program.
+    if (options.tierUpAfter) {
+        options.tierLevel = options.optLevel ? options.optLevel : 3;
+        options.optLevel = 0;
+    }
+
+    // Globals are thread-local under --threads, so a run's tasks must stay on the run's own thread.
+    if (options.threads) ucml::Scheduler::setWorkers(1);
+
+    if (!ucml::Input::open(inputs)) return 2;
+
+    if (files.empty()) {
+        options.importPaths.insert(options.importPaths.begin(), ".");
+        llvm::LLVMContext llvmContext;
+        ucml::Context context(llvmContext);
+        context.incremental = true;
+        ucml::Tools tools = ucml::Tools::initialize(nullptr, context, options);
+        return ucml::Repl(context, tools).run();
+    }
+    options.sourceFile = files[0];
+    // Libraries next to the source file come first.
+    std::string directory = llvm::sys::path::parent_path(files[0]).str();
+    options.importPaths.insert(options.importPaths.begin(), directory.empty() ? "." : directory);
+    if (library) {
+        llvm::LLVMContext llvmContext;
+        return ucml::Library::build(files[0], options, llvmContext) ? 0 : 3;
+    }
+    if (watch) return ucml::Watcher(files[0], options).run();
+
+    // The daemon keeps the programs it compiled, keyed by their source, the options they were compiled with and
+    // every library they import: a program seen before skips parsing, code generation and the optimizer.
+    std::string cacheKey;
+    if (cache && objectFile.empty() && bitcodeFile.empty() && !options.tierUpAfter && !options.debugInfo) {
+        std::ifstream file(files[0], std::ios::binary);
+        if (file.is_open()) {
+            std::stringstream source;
+            source << file.rdbuf();
+            std::string identity = options.cpu + ";" + options.features + ";O" + std::to_string(options.optLevel) +
+                                   (options.threads ? ";threads" : "");
+            for (auto &path : options.importPaths) identity += ";" + path;
+            cacheKey = "run;" + ucml::Watcher::fingerprint(
+                    identity + "\n" + source.str() + ucml::Library::importedSources(source.str(), options.importPaths));
+            llvm::StringRef ir = cache->lookup(cacheKey + ";ir");
+            if (!ir.empty() && !cache->lookup(cacheKey).empty())
+                return runCached(cacheKey, ir, files, options, cache, argv[0]);
+        }
+    }
+
+    // A precompiled program (see --emit-bc) skips straight to running.
+    bool precompiled = llvm::sys::path::extension(files[0]) == ".bc";
+    if (!precompiled) {
+        yyin = fopen(files[0], "r");
         if (!yyin) {
-            std::cerr << "====> Error! Cannot open file \"" << argv[1] << "\".\n";
+            std::cerr << "====> Error! Cannot open file \"" << files[0] << "\".\n";
             showUsage(argv[0]);
             return 2;
         }
+        if (yyparse()) { // non-zero means something went wrong.
+            std::cout << "-----------> SYNTAX ERROR FOUND <-----------\n";
+            return 4;
+        }
+        std::cout << "++++++++++++++> SYNTAX IS OK <++++++++++++++\n";
+    }
+
+    llvm::LLVMContext llvmContext;
+    ucml::Context context(llvmContext);
+    ucml::Tools tools = ucml::Tools::initialize(mainBlock, context, options);
+    llvm::Function *function;
+    if (precompiled) {
+        function = tools.loadProgram(files[0]);
+        if (!function) return 2;
+    } else {
+        tools.createBuiltInFunctions();
+        std::cout << "====> Generating Intermediate Representation (IR)...\n";
+        function = tools.generateCode();
+        tools.linkLibraries();
+        tools.optimize(function);
     }
-    if (yyparse()) { // non-zero means something went wrong.
-        std::cout << "-----------> SYNTAX ERROR FOUND <-----------\n";
-        return 4;
+    if (!cacheKey.empty()) {
+        // Found by name when a later run reuses the object code.
+        function->setLinkage(llvm::GlobalValue::ExternalLinkage);
+        context.module->setModuleIdentifier(cacheKey);
+        tools.setObjectCache(cache);
     }
-    std::cout << "++++++++++++++> SYNTAX IS OK <++++++++++++++\n";
+    std::string ir;
+    llvm::raw_string_ostream stream(ir);
+    tools.printIR(stream);
+    stream.flush();
+    if (!cacheKey.empty()) cache->share(cacheKey + ";ir", ir);
+    int status = dumpIR(ir, files, argv[0]);
+    if (status) return status;
+    if (!bitcodeFile.empty())
+        return tools.emitBitcode(bitcodeFile) ? 0 : 3;
+    if (!objectFile.empty())
+        return tools.emitObject(function, objectFile) ? 0 : 3;
+    if (options.threads) tools.runConcurrently(function, options.threads);
+    else if (options.tierUpAfter) tools.runTiered(function);
+    else tools.runCode(function);
+    return 0;
+}
 
+int runCached(const std::string &key, llvm::StringRef ir, const std::vector<char *> &files,
+              const ucml::Options &options, ucml::ObjectCache *cache, char *name) {
+    std::cout << "====> Program unchanged since an earlier run, reusing its compiled code...\n";
     llvm::LLVMContext llvmContext;
     ucml::Context context(llvmContext);
-    ucml::Tools tools = ucml::Tools::initialize(mainBlock, context);
-    tools.createBuiltInFunctions();
-    std::cout << "====> Generating Intermediate Representation (IR)...\n";
-    llvm::Function *function = tools.generateCode();
+    ucml::Tools tools = ucml::Tools::initialize(nullptr, context, options);
+    // An empty entry point is enough, the JIT takes the object code from the cache.
+    context.module->setModuleIdentifier(key);
+    auto *function = llvm::Function::Create(llvm::FunctionType::get(llvm::Type::getInt64Ty(llvmContext), false),
+                                            llvm::GlobalValue::ExternalLinkage, "main", context.module);
+    llvm::IRBuilder<>(llvm::BasicBlock::Create(llvmContext, "entry", function)).CreateUnreachable();
+    tools.setObjectCache(cache);
+    int status = dumpIR(ir, files, name);
+    if (status) return status;
+    if (options.threads) tools.runConcurrently(function, options.threads);
+    else tools.runCode(function);
+    return 0;
+}
+
+int dumpIR(llvm::StringRef ir, const std::vector<char *> &files, char *name) {
     std::cout << "====> IR generation completed, dumping now...\n";
-    if (argc > 2) {
-        std::error_code errorCode;
-        llvm::raw_fd_ostream fileStream(argv[2], errorCode, llvm::sys::fs::OpenFlags::F_None);
-        if (errorCode.value()) {
-            std::cerr << "====> Error! Cannot write to file \"" << argv[2] << "\", " << errorCode.message() << "\n";
-            showUsage(argv[0]);
-            return 3;
-        } else {
-            tools.printIR(fileStream);
-            std::cout << "====> IR dumped to file \"" << argv[2] << "\", you can now use it to\n"
-                                                                    "\t- run/execute the IR directly using \"lli\"\n"
-                                                                    "\t- generate llvm bitcode using \"llvm-as\"\n"
-                                                                    "\t- generate assembly-code using \"llc\"\n"
-                                                                    "  [!] provided that the tools mentioned above are installed in your machine.\n";
-        }
-    } else {
-        tools.printIR(llvm::outs());
+    if (files.size() < 2) {
+        llvm::outs() << ir;
+        return 0;
+    }
+    std::error_code errorCode;
+    llvm::raw_fd_ostream fileStream(files[1], errorCode, llvm::sys::fs::OpenFlags::F_None);
+    if (errorCode.value()) {
+        std::cerr << "====> Error! Cannot write to file \"" << files[1] << "\", " << errorCode.message() << "\n";
+        showUsage(name);
+        return 3;
     }
-    tools.runCode(function);
+    fileStream << ir;
+    std::cout << "====> IR dumped to file \"" << files[1] << "\", you can now use it to\n"
+                                                            "\t- run/execute the IR directly using \"lli\"\n"
+                                                            "\t- generate llvm bitcode using \"llvm-as\"\n"
+                                                            "\t- generate assembly-code using \"llc\"\n"
+                                                            "  [!] provided that the tools mentioned above are installed in your machine.\n";
     return 0;
 }
 
 void showUsage(char *name) {
-    std::cerr << "Usage: \n     " << name << " [<source-file.ml> [<out-file.ir>]]\n";
+    std::cerr << "Usage: \n     " << name << " [options] [<source-file.ml> [<out-file.ir>]]\n"
+                                              "     Without a source file an interactive session is started.\n"
+                                              "Options:\n"
+                                              "     -O<0-3>             Optimization level, default -O0.\n"
+                                              "     -mcpu=<name>        Target CPU, \"native\" (default when running) detects the host.\n"
+                                              "     -mattr=<features>   Target features, e.g. -mattr=+avx2,+fma,-avx512f\n"
+                                              "     --emit-obj=<file>   Compile ahead-of-time to an object file instead of running.\n"
+                                              "     --emit-bc=<file>    Save the compiled program as bitcode, run it later with \"uCML <file>\".\n"
+                                              "     -g                  Emit DWARF debug info and expose JIT'd code to gdb and perf.\n"
+                                              "     --tiered[=<n>]      Start at -O0, recompile functions called or looping n (1000) times at -O3.\n"
+                                              "     --threads=<n>       Run the program on n threads at once, each with its own globals.\n"
+                                              "     --workers=<n>       Run spawned tasks on n threads, default one per core.\n"
+                                              "     --input=<file>      Make \"file\" input stream 1, 2, ... of readint(), intat(), ... (0 is stdin).\n"
+                                              "     -I<directory>       Also search \"directory\" for imported libraries.\n"
+                                              "     --emit-lib          Compile the source file as a library (.bc code and .mli interface).\n"
+                                              "     --watch             Re-run the source file on every change, recompiling only changed functions.\n"
+                                              "     --daemon            Serve requests from \"uCMLc\" on a Unix socket ($UCML_SOCKET).\n";
 }
@@ -14,11 +14,15 @@
    limitations under the License.
 */
 #include <iostream>
+#include <set>
 #include <llvm/IR/Type.h>
 #include <llvm/IR/Constants.h>
 #include <llvm/IR/Instructions.h>
+#include <llvm/IR/Intrinsics.h>
 #include "nodes.hpp"
 #include "tools.hpp"
+#include "library.hpp"
+#include "input.hpp"
 #include "parser.hpp"
 
 namespace ucml {
@@ -38,9 +42,14 @@ namespace ucml {
 
     Double::Double(double value) : value(value) {}
 
+    Boolean::Boolean(bool value) : value(value) {}
+
     BinaryOperation::BinaryOperation(YYLTYPE location, int op, Expression &lhs, Expression &rhs) :
             location(location), operation(op), left(lhs), right(rhs) {}
 
+    LogicalOperation::LogicalOperation(YYLTYPE location, int op, Expression &lhs, Expression &rhs) :
+            location(location), operation(op), left(lhs), right(rhs) {}
+
     UnaryOperation::UnaryOperation(YYLTYPE location, int op, Expression &expr) : location(location), operation(op),
                                                                                  expression(expr) {}
 
@@ -49,22 +58,207 @@ namespace ucml {
 
     FunctionDeclaration::FunctionDeclaration(
             YYLTYPE location, const Identifier &type, const Identifier &name, Block *body, VariableList *params,
-            bool isExt) :
-            location(location), type(type), identifier(name), body(body), parameters(params), isExternal(isExt) {}
+            bool isExt, IdentifierList *typeParams) :
+            location(location), type(type), identifier(name), body(body), parameters(params), isExternal(isExt),
+            typeParameters(typeParams) {}
 
-    FunctionCall::FunctionCall(YYLTYPE location, const Identifier &name, ExpressionList *args) : location(location),
-                                                                                                 identifier(name),
-                                                                                                 args(args) {}
+    FunctionCall::FunctionCall(YYLTYPE location, const Identifier &name, ExpressionList *args, bool isSpawned) :
+            location(location), identifier(name), args(args), consumesGenerator(false), isSpawned(isSpawned) {}
+
+    LoopHint::LoopHint(const Identifier &name, long long value) : name(name), value(value) {}
 
     ForLoop::ForLoop(Identifier &varName, const Identifier &type,
-                     Expression &from, Expression &to, Block &body, Expression *by) :
-            name(varName), type(type), from(from), to(to), body(body), by(by) {}
+                     Expression &from, Expression &to, Block &body, Expression *by, LoopHintList *hints) :
+            name(varName), type(type), from(from), to(to), body(body), by(by), hints(hints) {}
+
+    GeneratorLoop::GeneratorLoop(YYLTYPE location, Identifier &varName, const Identifier &type, Expression &source,
+                                 Block &body) : location(location), name(varName), type(type), source(source),
+                                                body(body) {}
 
     IfCondition::IfCondition(YYLTYPE location, Expression &cond, Block &thenBlock, Block *elseBlock) :
             location(location), condition(cond), thenBlock(thenBlock), elseBlock(elseBlock) {}
 
+    MatchStatement::MatchStatement(YYLTYPE location, Expression &subject, MatchArmList *arms) : location(location),
+                                                                                               subject(subject),
+                                                                                               arms(arms) {}
+
+    ImportStatement::ImportStatement(YYLTYPE location, const Identifier &name) : location(location),
+                                                                                  identifier(name) {}
+
     ReturnStatement::ReturnStatement(YYLTYPE location, Expression *expr) : location(location), expression(expr) {}
 
+    YieldStatement::YieldStatement(YYLTYPE location, Expression &expr) : location(location), expression(expr) {}
+
+    /*******************************\
+    *          Generators           *
+    \*******************************/
+    // Whether a "yield" appears anywhere in the given code, which makes the function around it a generator.
+    static bool containsYield(Node *node) {
+        if (dynamic_cast<YieldStatement *>(node)) return true;
+        if (auto *block = dynamic_cast<Block *>(node)) {
+            for (auto *statement : block->statements) {
+                if (containsYield(statement)) return true;
+            }
+        } else if (auto *condition = dynamic_cast<IfCondition *>(node)) {
+            return containsYield(&condition->thenBlock) || containsYield(condition->elseBlock);
+        } else if (auto *loop = dynamic_cast<ForLoop *>(node)) {
+            return containsYield(&loop->body);
+        } else if (auto *generatorLoop = dynamic_cast<GeneratorLoop *>(node)) {
+            return containsYield(&generatorLoop->body);
+        } else if (auto *match = dynamic_cast<MatchStatement *>(node)) {
+            for (auto *arm : *match->arms) {
+                if (containsYield(arm->body)) return true;
+            }
+        }
+        return false;
+    }
+
+    static llvm::Function *intrinsic(Context &context, llvm::Intrinsic::ID id) {
+        return llvm::Intrinsic::getDeclaration(context.module, id);
+    }
+
+    static llvm::Function *runtimeFunction(Context &context, const std::string &name, llvm::FunctionType *type) {
+        llvm::Function *function = context.module->getFunction(name);
+        return function ? function : llvm::Function::Create(type, llvm::GlobalValue::ExternalLinkage, name,
+                                                             context.module);
+    }
+
+    // Generators that "for" loops of the given function are iterating over right now, innermost first.
+    static std::vector<llvm::Value *> iteratedIn(Context &context, llvm::Function *function) {
+        std::vector<llvm::Value *> handles;
+        for (auto handle = context.iterated.rbegin(); handle != context.iterated.rend(); ++handle) {
+            if (llvm::cast<llvm::Instruction>(*handle)->getFunction() == function) handles.push_back(*handle);
+        }
+        return handles;
+    }
+
+    // Turns the function being generated into a switched-resume coroutine (see LLVM's "Coroutines" document),
+    // continuing in the block after its prologue. The frame comes from malloc unless CoroElide can prove the
+    // consumer never lets the handle escape, then it lives in the consumer's own frame.
+    static Generator startGenerator(Context &context, llvm::Function *function, llvm::Type *elementType) {
+        Generator generator{};
+        generator.function = function;
+        generator.finish = llvm::BasicBlock::Create(context.llvmContext, "finish");
+        generator.cleanup = llvm::BasicBlock::Create(context.llvmContext, "cleanup");
+        generator.suspend = llvm::BasicBlock::Create(context.llvmContext, "suspend");
+        llvm::BasicBlock *entry = context.getCurrentBlock(),
+                *allocate = llvm::BasicBlock::Create(context.llvmContext, "allocate", function),
+                *begin = llvm::BasicBlock::Create(context.llvmContext, "begin", function);
+
+        // Marks it for CoroSplit; CoroEarly of LLVM 8 would add it too, newer versions expect it from the front end.
+        function->addFnAttr("coroutine.presplit", "0");
+        llvm::IRBuilder<> builder(entry);
+        llvm::Type *bytePointer = builder.getInt8PtrTy();
+        llvm::Value *null = llvm::ConstantPointerNull::get(builder.getInt8PtrTy());
+        unsigned alignment = context.module->getDataLayout().getABITypeAlignment(elementType);
+        generator.promise = builder.CreateAlloca(elementType, nullptr, "promise");
+        generator.id = builder.CreateCall(intrinsic(context, llvm::Intrinsic::coro_id),
+                                          {builder.getInt32(alignment),
+                                           builder.CreateBitCast(generator.promise, bytePointer), null, null}, "id");
+        builder.CreateCondBr(builder.CreateCall(intrinsic(context, llvm::Intrinsic::coro_alloc), {generator.id}),
+                             allocate, begin);
+
+        builder.SetInsertPoint(allocate);
+        llvm::Value *size = builder.CreateCall(llvm::Intrinsic::getDeclaration(
+                context.module, llvm::Intrinsic::coro_size, {builder.getInt64Ty()}), {}, "size");
+        llvm::Function *malloc = runtimeFunction(context, "malloc",
+                                                 llvm::FunctionType::get(bytePointer, {builder.getInt64Ty()}, false));
+        llvm::Value *memory = builder.CreateCall(malloc, {size}, "memory");
+        builder.CreateBr(begin);
+
+        builder.SetInsertPoint(begin);
+        llvm::PHINode *frame = builder.CreatePHI(bytePointer, 2, "frame");
+        frame->addIncoming(null, entry);
+        frame->addIncoming(memory, allocate);
+        generator.handle = builder.CreateCall(intrinsic(context, llvm::Intrinsic::coro_begin), {generator.id, frame},
+                                              "handle");
+        context.setCurrentBlock(begin);
+        return generator;
+    }
+
+    // Ends the body with the final suspend point, then the blocks freeing the frame and returning the handle.
+    static void finishGenerator(Context &context, Generator &generator) {
+        llvm::Function *function = generator.function;
+        llvm::IRBuilder<> builder(context.getCurrentBlock());
+        if (!context.getCurrentBlock()->getTerminator()) builder.CreateBr(generator.finish);
+        llvm::Type *bytePointer = builder.getInt8PtrTy();
+
+        generator.finish->insertInto(function);
+        builder.SetInsertPoint(generator.finish);
+        // Done: a consumer may only destroy it from here on, resuming it again is undefined.
+        llvm::Value *state = builder.CreateCall(intrinsic(context, llvm::Intrinsic::coro_suspend),
+                                                {llvm::ConstantTokenNone::get(context.llvmContext), builder.getTrue()},
+                                                "final");
+        builder.CreateSwitch(state, generator.suspend, 1)->addCase(builder.getInt8(1), generator.cleanup);
+
+        generator.cleanup->insertInto(function);
+        builder.SetInsertPoint(generator.cleanup);
+        llvm::Value *memory = builder.CreateCall(intrinsic(context, llvm::Intrinsic::coro_free),
+                                                 {generator.id, generator.handle}, "memory");
+        llvm::BasicBlock *release = llvm::BasicBlock::Create(context.llvmContext, "release", function);
+        builder.CreateCondBr(builder.CreateIsNotNull(memory), release, generator.suspend);
+        builder.SetInsertPoint(release);
+        llvm::Function *free = runtimeFunction(context, "free", llvm::FunctionType::get(
+                builder.getVoidTy(), {bytePointer}, false));
+        builder.CreateCall(free, {memory});
+        builder.CreateBr(generator.suspend);
+
+        generator.suspend->insertInto(function);
+        builder.SetInsertPoint(generator.suspend);
+        builder.CreateCall(intrinsic(context, llvm::Intrinsic::coro_end), {generator.handle, builder.getFalse()});
+        builder.CreateRet(generator.handle);
+    }
+
+    /*******************************\
+    *            Tasks              *
+    \*******************************/
+    // What a task of the given function carries: its result (a byte for void functions), then its arguments.
+    static llvm::StructType *taskFrame(Context &context, llvm::Function *callee) {
+        llvm::Type *result = callee->getReturnType();
+        std::vector<llvm::Type *> fields{result->isVoidTy() ? llvm::Type::getInt8Ty(context.llvmContext) : result};
+        for (auto &argument : callee->args()) fields.push_back(argument.getType());
+        return llvm::StructType::get(context.llvmContext, fields);
+    }
+
+    // "callee.task", what a worker runs: unpacks the arguments, calls the function and stores its result.
+    static llvm::Function *taskEntry(Context &context, llvm::Function *callee) {
+        std::string name = callee->getName().str() + ".task";
+        if (llvm::Function *entry = context.module->getFunction(name)) return entry;
+        llvm::IRBuilder<> builder(context.llvmContext);
+        auto *entry = llvm::Function::Create(llvm::FunctionType::get(builder.getVoidTy(), {builder.getInt8PtrTy()},
+                                                                     false),
+                                             llvm::GlobalValue::InternalLinkage, name, context.module);
+        builder.SetInsertPoint(llvm::BasicBlock::Create(context.llvmContext, "entry", entry));
+        llvm::StructType *frameType = taskFrame(context, callee);
+        llvm::Value *frame = builder.CreateBitCast(entry->arg_begin(), frameType->getPointerTo(), "frame");
+        std::vector<llvm::Value *> arguments;
+        for (unsigned i = 0; i < callee->arg_size(); ++i)
+            arguments.push_back(builder.CreateLoad(builder.CreateStructGEP(frameType, frame, i + 1)));
+        llvm::Value *result = builder.CreateCall(callee, arguments);
+        if (!callee->getReturnType()->isVoidTy())
+            builder.CreateStore(result, builder.CreateStructGEP(frameType, frame, 0));
+        builder.CreateRetVoid();
+        return entry;
+    }
+
+    // Result type of the task held by the given handle: a "spawn" itself, or a load of a local variable every store
+    // to which is one with the same result type. Null when that cannot be told.
+    static llvm::Type *taskResult(Context &context, llvm::Value *handle) {
+        auto spawned = context.tasks.find(handle);
+        if (spawned != context.tasks.end()) return spawned->second;
+        auto *load = llvm::dyn_cast<llvm::LoadInst>(handle);
+        if (!load || !llvm::isa<llvm::AllocaInst>(load->getPointerOperand())) return nullptr;
+        llvm::Type *result = nullptr;
+        for (llvm::User *user : load->getPointerOperand()->users()) {
+            auto *store = llvm::dyn_cast<llvm::StoreInst>(user);
+            if (!store) continue;
+            auto task = context.tasks.find(store->getValueOperand());
+            if (task == context.tasks.end() || (result && result != task->second)) return nullptr;
+            result = task->second;
+        }
+        return result;
+    }
+
     /*******************************\
     *       Code Generators         *
     \*******************************/
@@ -82,29 +276,31 @@ namespace ucml {
     }
 
     llvm::Value *VariableDeclaration::generateCode(Context &context) {
-        if (!Tools::isValidType(type.name)) {
-            FATAL(location, "Invalid type \"" << type.name << "\"");
+        const std::string &typeName = context.resolveType(type.name);
+        // Tasks only live in local variables, where join() can tell what they return.
+        if (!Tools::isValidType(typeName) && !(typeName == "task" && context.size() > 1)) {
+            FATAL(location, "Invalid type \"" << typeName << "\"");
             return nullptr;
         }
+        llvm::Type *valueType = Tools::typeOf(typeName, context.llvmContext);
 
         if (context.size() <= 1) { // means global scope
-            if (context.module->getNamedGlobal(identifier.name)) {
+            if (context.getGlobal(identifier.name)) {
                 FATAL(location, "Global variable \"" << identifier.name << "\" is already declared.");
                 return nullptr;
             }
-            llvm::Type *valueType = Tools::typeOf(type, context.llvmContext);
-            llvm::IRBuilder<> builder(context.getCurrentBlock());
-            llvm::Constant *defaultValue =
-                    type.name == "int" ? builder.getInt64(0) : llvm::ConstantFP::get(builder.getDoubleTy(), 0.0);
-            new llvm::GlobalVariable(*context.module, valueType, false, llvm::GlobalValue::InternalLinkage,
-                                     defaultValue,
-                                     identifier.name);
+            auto *variable = new llvm::GlobalVariable(*context.module, valueType, false, context.definitionLinkage(),
+                                                      llvm::Constant::getNullValue(valueType), identifier.name);
+            Tools::declareDebugVariable(context, variable, valueType, identifier);
         } else {
             if (context.getSymbols().find(identifier.name) == context.getSymbols().end()) {
-                auto *allocationInst = new llvm::AllocaInst(Tools::typeOf(type, context.llvmContext),
-                                                            0, identifier.name, context.getCurrentBlock());
-                context.getSymbols()[identifier.name] = std::make_pair(Tools::typeOf(type, context.llvmContext),
-                                                                       allocationInst);
+                auto *allocationInst = new llvm::AllocaInst(valueType, 0, identifier.name, context.getCurrentBlock());
+                context.defineSymbol(identifier.name, valueType, allocationInst);
+                if (typeName == "task") {
+                    context.taskVariables[allocationInst] = {context.getCurrentScope(), identifier.name,
+                                                             location.first_line, location.first_column, false};
+                }
+                Tools::declareDebugVariable(context, allocationInst, allocationInst->getAllocatedType(), identifier);
             } else {
                 FATAL(location, "Variable \"" << identifier.name << "\" is already defined.");
                 return nullptr;
@@ -119,8 +315,12 @@ namespace ucml {
 
     llvm::Value *Block::generateCode(Context &context) {
         llvm::Value *lastStatement = nullptr;
-        for (auto &statement : statements) {
-            lastStatement = statement->generateCode(context);
+        for (size_t i = 0; i < statements.size(); ++i) {
+            llvm::BasicBlock *block =
+                    context.debugBuilder && i < locations.size() ? context.getCurrentBlock() : nullptr;
+            llvm::Instruction *last = block && !block->empty() ? &block->back() : nullptr;
+            lastStatement = statements[i]->generateCode(context);
+            if (block) Tools::attachDebugLocation(context, block, last, locations[i]);
         }
         return lastStatement;
     }
@@ -133,29 +333,35 @@ namespace ucml {
         return llvm::ConstantFP::get(llvm::Type::getDoubleTy(context.llvmContext), value);
     }
 
+    llvm::Value *Boolean::generateCode(Context &context) {
+        return llvm::ConstantInt::get(llvm::Type::getInt1Ty(context.llvmContext), value);
+    }
+
     llvm::Value *ExprStatement::generateCode(Context &context) {
         return expression.generateCode(context);
     }
 
     llvm::Value *BinaryOperation::generateCode(Context &context) {
-        llvm::Value *leftValue = left.generateCode(context), *rightValue = right.generateCode(context);
-        if (!(leftValue && rightValue)) return nullptr;
-        bool isFP = false;
-        if (leftValue->getType()->getTypeID() == leftValue->getType()->DoubleTyID) {
-            isFP = true;
-            if (rightValue->getType()->getTypeID() == rightValue->getType()->IntegerTyID) {
-                W(location, "Converting integer to double.");
-                rightValue = new llvm::SIToFPInst(rightValue, leftValue->getType(), "casted",
-                                                  context.getCurrentBlock());
-            }
+        // "a + b + c + ..." nests to the left as deep as it is long (generated code does that), so walk down the
+        // left operands in a loop rather than recursing once per operator.
+        std::vector<BinaryOperation *> chain{this};
+        while (auto *inner = dynamic_cast<BinaryOperation *>(&chain.back()->left)) chain.push_back(inner);
+        llvm::Value *value = chain.back()->left.generateCode(context);
+        for (auto operation = chain.rbegin(); operation != chain.rend() && value; ++operation)
+            value = (*operation)->apply(context, value);
+        return value;
+    }
 
-        } else if (rightValue->getType()->getTypeID() == rightValue->getType()->DoubleTyID) {
-            isFP = true;
-            if (leftValue->getType()->getTypeID() == leftValue->getType()->IntegerTyID) {
-                W(location, "Converting integer to double.");
-                leftValue = new llvm::SIToFPInst(leftValue, rightValue->getType(), "casted", context.getCurrentBlock());
-            }
-        }
+    llvm::Value *BinaryOperation::apply(Context &context, llvm::Value *leftValue) {
+        llvm::Value *rightValue = right.generateCode(context);
+        if (!(leftValue && rightValue)) return nullptr;
+        llvm::Type *type = Tools::commonType(leftValue, rightValue);
+        // A bool is 0 or 1, but -1 to signed i1 arithmetic and ordering: only == and != stay on bools.
+        if (type->isIntegerTy(1) && operation != EQ && operation != NE)
+            type = llvm::Type::getInt64Ty(context.llvmContext);
+        leftValue = Tools::castValue(context, leftValue, type, location);
+        rightValue = Tools::castValue(context, rightValue, type, location);
+        bool isFP = type->isFloatingPointTy();
 
         llvm::IRBuilder<> irBuilder(context.getCurrentBlock());
         switch (operation) {
@@ -192,6 +398,49 @@ namespace ucml {
         }
     }
 
+    llvm::Value *LogicalOperation::generateCode(Context &context) {
+        // Long "a && b && c && ..." chains nest to the left too, see BinaryOperation::generateCode().
+        std::vector<LogicalOperation *> chain{this};
+        while (auto *inner = dynamic_cast<LogicalOperation *>(&chain.back()->left)) chain.push_back(inner);
+        llvm::Value *value = chain.back()->left.generateCode(context);
+        for (auto operation = chain.rbegin(); operation != chain.rend(); ++operation)
+            value = (*operation)->apply(context, value);
+        return value;
+    }
+
+    llvm::Value *LogicalOperation::apply(Context &context, llvm::Value *leftValue) {
+        if (!leftValue) {
+            FATAL(location, "Invalid operand");
+            return nullptr;
+        }
+        leftValue = Tools::toCondition(context, leftValue);
+        // The right operand is only evaluated when the left one does not decide the result.
+        llvm::BasicBlock *leftBlock = context.getCurrentBlock();
+        llvm::Function *function = leftBlock->getParent();
+        llvm::BasicBlock
+                *rightBlock = llvm::BasicBlock::Create(context.llvmContext, operation == AND ? "and" : "or", function),
+                *mergeBlock = llvm::BasicBlock::Create(context.llvmContext, "decided", function);
+        if (operation == AND) llvm::BranchInst::Create(rightBlock, mergeBlock, leftValue, leftBlock);
+        else llvm::BranchInst::Create(mergeBlock, rightBlock, leftValue, leftBlock);
+
+        context.setCurrentBlock(rightBlock);
+        llvm::Value *rightValue = right.generateCode(context);
+        if (!rightValue) {
+            FATAL(location, "Invalid operand");
+            return nullptr;
+        }
+        rightValue = Tools::toCondition(context, rightValue);
+        llvm::BasicBlock *rightEnd = context.getCurrentBlock();
+        llvm::BranchInst::Create(mergeBlock, rightEnd);
+
+        context.setCurrentBlock(mergeBlock);
+        llvm::IRBuilder<> builder(mergeBlock);
+        llvm::PHINode *result = builder.CreatePHI(builder.getInt1Ty(), 2, operation == AND ? "and" : "or");
+        result->addIncoming(builder.getInt1(operation == OR), leftBlock);
+        result->addIncoming(rightValue, rightEnd);
+        return result;
+    }
+
     llvm::Value *UnaryOperation::generateCode(Context &context) {
         llvm::IRBuilder<> builder(context.getCurrentBlock());
         llvm::Value *value = expression.generateCode(context);
@@ -201,9 +450,11 @@ namespace ucml {
         }
         switch (operation) {
             case '-':
-                if (value->getType()->getTypeID() == value->getType()->DoubleTyID)
-                    return builder.CreateFSub(llvm::ConstantFP::get(builder.getDoubleTy(), 0), value);
-                return builder.CreateSub(builder.getInt64(0), value);
+                if (value->getType()->isFloatingPointTy())
+                    return builder.CreateFSub(llvm::ConstantFP::get(value->getType(), 0), value);
+                return builder.CreateSub(llvm::ConstantInt::get(value->getType(), 0), value);
+            case '!':
+                return builder.CreateNot(Tools::toCondition(context, value), "not");
         }
         return nullptr;
     }
@@ -221,60 +472,122 @@ namespace ucml {
             return nullptr;
         }
 
-        llvm::Type::TypeID type = destination->first->getTypeID();
-
-        if (type == llvm::Type::TypeID::IntegerTyID) {
-            if (value->getType()->getTypeID() == llvm::Type::TypeID::DoubleTyID) {
-                W(location, "Truncating double to fit integer variable.");
-                value = new llvm::FPToSIInst(value, destination->first, "casted", context.getCurrentBlock());
-            }
-        } else if (type == llvm::Type::TypeID::DoubleTyID) {
-            if (value->getType()->getTypeID() == llvm::Type::TypeID::IntegerTyID) {
-                W(location, "Converting integer to double.");
-                value = new llvm::SIToFPInst(value, destination->first, "casted", context.getCurrentBlock());
-            }
-        }
+        value = Tools::castValue(context, value, destination->first, location);
         new llvm::StoreInst(value, destination->second, context.getCurrentBlock());
         return value;
     }
 
-    llvm::Value *FunctionDeclaration::generateCode(Context &context) {
-        if (context.size() > 1) {
-            FATAL(location, "Local functions are not supported yet.");
-            return nullptr;
-        }
-        if (!Tools::isValidType(type.name, true)) {
-            FATAL(location, "Invalid return type \"" << type.name << "\".");
-            return nullptr;
-        }
-        // Protect our dummy built-in function: echo(number) too!
-        if (identifier.name == "echo" || context.module->getFunction(identifier.name)) {
-            FATAL(location, "Function with name \"" << identifier.name << "\" is already defined.");
+    llvm::FunctionType *FunctionDeclaration::getFunctionType(Context &context) {
+        const std::string &returnType = context.resolveType(type.name);
+        if (!Tools::isValidType(returnType, true)) {
+            FATAL(location, "Invalid return type \"" << returnType << "\".");
             return nullptr;
         }
         std::vector<llvm::Type *> argTypes;
         if (parameters) {
             for (auto &arg : *parameters) {
-                if (Tools::isValidType(arg->type.name))
-                    argTypes.push_back(Tools::typeOf(arg->type, context.llvmContext));
+                const std::string &argType = context.resolveType(arg->type.name);
+                if (Tools::isValidType(argType))
+                    argTypes.push_back(Tools::typeOf(argType, context.llvmContext));
                 else {
-                    FATAL(location, "Invalid parameter type \"" << arg->type.name << "\"");
+                    FATAL(location, "Invalid parameter type \"" << argType << "\"");
                     return nullptr;
                 }
             }
         }
+        if (!isGenerator()) {
+            return llvm::FunctionType::get(Tools::typeOf(returnType, context.llvmContext),
+                                           llvm::makeArrayRef(argTypes), false);
+        }
+        if (returnType == "void") {
+            FATAL(location, "Generator \"" << identifier.name << "\" must declare the type of the values it yields.");
+            return nullptr;
+        }
+        // A generator returns the handle of its coroutine, the values it yields are read through that.
+        return llvm::FunctionType::get(llvm::Type::getInt8PtrTy(context.llvmContext), llvm::makeArrayRef(argTypes),
+                                       false);
+    }
 
-        llvm::FunctionType *functionType = llvm::FunctionType::get(Tools::typeOf(type, context.llvmContext),
-                                                                   llvm::makeArrayRef(argTypes), false);
+    bool FunctionDeclaration::isGenerator() const {
+        return body && containsYield(body);
+    }
+
+    bool FunctionDeclaration::isTypeParameter(const std::string &typeName) const {
+        if (!typeParameters) return false;
+        for (auto *parameter : *typeParameters) {
+            if (parameter->name == typeName) return true;
+        }
+        return false;
+    }
+
+    llvm::Function *FunctionDeclaration::instantiate(Context &context,
+                                                     const std::map<std::string, std::string> &typeArguments) {
+        std::string name = identifier.name + "<";
+        for (auto *parameter : *typeParameters) name += typeArguments.at(parameter->name) + ",";
+        name.back() = '>';
+        // Every instantiation is generated once, later calls with the same types share it.
+        llvm::Function *function = context.getFunction(name);
+        if (function) return function;
+
+        // Generate the specialization as if it was written at the top level, then resume where the call was.
+        std::map<std::string, std::string> outerArguments = typeArguments;
+        context.typeArguments.swap(outerArguments);
+        std::stack<Scope *> scopes = context.suspendScopes();
+        function = generateFunction(context, name);
+        context.resumeScopes(scopes);
+        context.typeArguments.swap(outerArguments);
+        // Private to the module, so every module of an incremental session instantiates its own copy.
+        function->setLinkage(llvm::GlobalValue::InternalLinkage);
+        return function;
+    }
+
+    llvm::Value *FunctionDeclaration::generateCode(Context &context) {
+        if (context.size() > 1) {
+            FATAL(location, "Local functions are not supported yet.");
+            return nullptr;
+        }
+        if (typeParameters) {
+            // Nothing to generate until a call tells which types to specialize it for.
+            if (identifier.name == "echo" || identifier.name == "join" || Input::isBuiltIn(identifier.name) ||
+                context.templates.count(identifier.name) || context.getFunction(identifier.name)) {
+                FATAL(location, "Function with name \"" << identifier.name << "\" is already defined.");
+                return nullptr;
+            }
+            context.templates[identifier.name] = this;
+            return nullptr;
+        }
+        return generateFunction(context, identifier.name);
+    }
+
+    llvm::Function *FunctionDeclaration::generateFunction(Context &context, const std::string &name) {
+        // Protect our dummy built-in functions: echo(number), join(task) and the input ones too!
+        if (name == "echo" || name == "join" || Input::isBuiltIn(name) || context.templates.count(name) ||
+            context.getFunction(name)) {
+            FATAL(location, "Function with name \"" << name << "\" is already defined.");
+            return nullptr;
+        }
+        llvm::FunctionType *functionType = getFunctionType(context);
         llvm::Function *function = llvm::Function::Create(functionType,
                                                           (isExternal ? llvm::GlobalValue::ExternalLinkage
-                                                                      : llvm::GlobalValue::InternalLinkage),
-                                                          identifier.name, context.module);
+                                                                      : context.definitionLinkage()),
+                                                          name, context.module);
         function->setCallingConv(llvm::CallingConv::C);
         if (isExternal)
             return function;
+        Tools::createDebugFunction(context, function, location);
         llvm::BasicBlock *basicBlock = llvm::BasicBlock::Create(context.llvmContext, "entry", function, nullptr);
         context.createNewScope(basicBlock);
+        // Instantiating a generic function may happen in the middle of generating a generator.
+        Generator *outerGenerator = context.generator;
+        Generator generator{};
+        context.generator = nullptr;
+        if (isGenerator()) {
+            const std::string &elementType = context.resolveType(type.name);
+            context.generators[name] = elementType;
+            function->addFnAttr("ucml-generator", elementType);
+            generator = startGenerator(context, function, Tools::typeOf(elementType, context.llvmContext));
+            context.generator = &generator;
+        }
         llvm::Function::arg_iterator iterator = function->arg_begin();
         llvm::Value *argValue;
         llvm::IRBuilder<> builder(context.getCurrentBlock());
@@ -288,17 +601,235 @@ namespace ucml {
         }
         body->generateCode(context);
         builder.SetInsertPoint(context.getCurrentBlock());
-        if (!context.getCurrentBlock()->getTerminator()) {
-            if (type.name == "void") builder.CreateRetVoid();
-            else if (type.name == "int") builder.CreateRet(builder.getInt64(1));
-            else builder.CreateRet(llvm::ConstantFP::get(builder.getDoubleTy(), 1.0));
+        if (context.generator) {
+            finishGenerator(context, generator);
+        } else if (!context.getCurrentBlock()->getTerminator()) {
+            llvm::Type *returnType = function->getReturnType();
+            if (returnType->isVoidTy()) builder.CreateRetVoid();
+            else if (returnType->isIntegerTy()) builder.CreateRet(llvm::ConstantInt::get(returnType, 1));
+            else builder.CreateRet(llvm::ConstantFP::get(returnType, 1.0));
         }
+        context.generator = outerGenerator;
         context.closeCurrentScope();
         return function;
     }
 
+    llvm::Value *FunctionCall::generateGenericCall(Context &context, FunctionDeclaration &generic) {
+        size_t count = generic.parameters ? generic.parameters->size() : 0, given = args ? args->size() : 0;
+        if (count != given) {
+            FATAL(location, "Function \"" << identifier.name << "\" accepts " << count << " argument" <<
+                                           (count == 1 ? "" : "s") << " but " << given <<
+                                           (given == 1 ? " was" : " were") << " given.");
+            return nullptr;
+        }
+        // Infer every type parameter from the arguments passed for it.
+        std::vector<llvm::Value *> arguments;
+        std::map<std::string, std::string> typeArguments;
+        for (size_t i = 0; i < count; ++i) {
+            llvm::Value *value = (*args)[i]->generateCode(context);
+            if (!value) {
+                FATAL(location, "Invalid argument provided");
+                return nullptr;
+            }
+            arguments.push_back(value);
+            const std::string &typeName = (*generic.parameters)[i]->type.name;
+            if (!generic.isTypeParameter(typeName)) continue;
+            std::string argumentType = Tools::nameOf(value->getType());
+            if (!Tools::isValidType(argumentType)) {
+                FATAL(location, "Cannot infer type parameter \"" << typeName << "\" from argument " << i + 1 << ".");
+                return nullptr;
+            }
+            auto bound = typeArguments.find(typeName);
+            if (bound == typeArguments.end()) {
+                typeArguments[typeName] = argumentType;
+            } else if (bound->second != argumentType) {
+                // Mixed numbers instantiate the type both convert to, as arithmetic on them would.
+                std::string common = Tools::nameOf(Tools::commonType(
+                        Tools::typeOf(bound->second, context.llvmContext), value->getType()));
+                W(location, "Instantiating \"" << typeName << "\" as " << common << " for mixed " << bound->second
+                                                << " and " << argumentType << " arguments.");
+                bound->second = common;
+            }
+        }
+        for (auto *parameter : *generic.typeParameters) {
+            if (!typeArguments.count(parameter->name)) {
+                FATAL(location, "Cannot infer type parameter \"" << parameter->name << "\" of \"" << identifier.name
+                                                                  << "\".");
+                return nullptr;
+            }
+        }
+
+        llvm::Function *function = generic.instantiate(context, typeArguments);
+        if (!consumesGenerator && context.generators.count(function->getName().str())) {
+            FATAL(location, "Generator \"" << identifier.name << "\" can only be iterated over: for (x:"
+                                            << context.generators[function->getName().str()] << " in "
+                                            << identifier.name << "(...)) {...}");
+            return nullptr;
+        }
+        auto parameter = function->arg_begin();
+        for (auto &argument : arguments) {
+            argument = Tools::castValue(context, argument, parameter->getType(), location);
+            ++parameter;
+        }
+        return llvm::IRBuilder<>(context.getCurrentBlock()).CreateCall(function, llvm::makeArrayRef(arguments));
+    }
+
+    llvm::Value *FunctionCall::generateInputCall(Context &context) {
+        const std::string &name = identifier.name;
+        bool isIndexed = name == "intat" || name == "doubleat";
+        size_t given = args ? args->size() : 0;
+        if (isIndexed ? given != 2 : given > 1) {
+            FATAL(location, "Function \"" << name << (isIndexed ? "(stream, row)\" requires exactly two arguments."
+                                                                : "(stream)\" accepts at most one argument."));
+            return nullptr;
+        }
+        llvm::Type *int64 = llvm::Type::getInt64Ty(context.llvmContext);
+        std::vector<llvm::Value *> arguments;
+        for (size_t i = 0; i < given; ++i) {
+            llvm::Value *value = (*args)[i]->generateCode(context);
+            if (!value) {
+                FATAL(location, "Invalid argument provided");
+                return nullptr;
+            }
+            arguments.push_back(Tools::castValue(context, value, int64, location));
+        }
+        llvm::Value *stream = given ? arguments[0] : llvm::ConstantInt::get(int64, 0); // stdin by default.
+
+        llvm::IRBuilder<> builder(context.getCurrentBlock());
+        auto runtime = [&](const char *function, llvm::Type *result) {
+            return runtimeFunction(context, function, llvm::FunctionType::get(result, {int64}, false));
+        };
+        if (name == "readint") return builder.CreateCall(runtime("ucml_read_int", int64), {stream});
+        if (name == "readdouble")
+            return builder.CreateCall(runtime("ucml_read_double", builder.getDoubleTy()), {stream});
+        if (name == "ended") {
+            return builder.CreateICmpNE(builder.CreateCall(runtime("ucml_input_ended", int64), {stream}),
+                                        llvm::ConstantInt::get(int64, 0), "ended");
+        }
+        // A column only depends on input state held by the runtime: the calls may be hoisted out of loops that
+        // do not read the stream as text, but never moved across readint()/readdouble() calls.
+        auto column = [&](const char *function, llvm::Type *result) {
+            llvm::Function *callee = runtime(function, result);
+            callee->addFnAttr(llvm::Attribute::ReadOnly);
+            callee->addFnAttr(llvm::Attribute::InaccessibleMemOnly);
+            callee->addFnAttr(llvm::Attribute::NoUnwind);
+            return builder.CreateCall(callee, {stream});
+        };
+        llvm::Value *rows = column("ucml_input_rows", int64);
+        if (name == "rows") return rows;
+
+        // Rows past the end stop the program instead of reading whatever follows the column.
+        llvm::Value *row = arguments[1];
+        llvm::Function *function = context.getCurrentBlock()->getParent();
+        llvm::BasicBlock *outside = llvm::BasicBlock::Create(context.llvmContext, "outside", function),
+                *inside = llvm::BasicBlock::Create(context.llvmContext, "inside", function);
+        builder.CreateCondBr(builder.CreateICmpULT(row, rows), inside, outside);
+        builder.SetInsertPoint(outside);
+        llvm::Function *fail = runtimeFunction(context, "ucml_input_out_of_range", llvm::FunctionType::get(
+                builder.getVoidTy(), {int64, int64}, false));
+        fail->addFnAttr(llvm::Attribute::NoReturn);
+        fail->addFnAttr(llvm::Attribute::Cold);
+        builder.CreateCall(fail, {stream, row});
+        builder.CreateUnreachable();
+        context.setCurrentBlock(inside);
+        builder.SetInsertPoint(inside);
+
+        llvm::Value *data = column("ucml_input_data", builder.getInt8PtrTy());
+        llvm::Type *valueType = name == "intat" ? int64 : builder.getDoubleTy();
+        llvm::Value *values = builder.CreateBitCast(data, valueType->getPointerTo());
+        return builder.CreateLoad(builder.CreateInBoundsGEP(valueType, values, row), "value");
+    }
+
+    llvm::Value *FunctionCall::generateSpawn(Context &context, llvm::Value *call) {
+        // The call was generated as usual (arguments converted, generics specialized), now it becomes a task.
+        auto *callInst = llvm::dyn_cast_or_null<llvm::CallInst>(call);
+        llvm::Function *callee = callInst ? callInst->getCalledFunction() : nullptr;
+        if (!callee) {
+            FATAL(location, "Cannot spawn \"" << identifier.name << "()\", only functions can run as tasks.");
+            return nullptr;
+        }
+        std::vector<llvm::Value *> arguments(callInst->arg_begin(), callInst->arg_end());
+        callInst->eraseFromParent();
+
+        llvm::IRBuilder<> builder(context.getCurrentBlock());
+        llvm::Type *bytePointer = builder.getInt8PtrTy(), *voidType = builder.getVoidTy();
+        llvm::StructType *frameType = taskFrame(context, callee);
+        llvm::Function *entry = taskEntry(context, callee);
+        llvm::Function *create = runtimeFunction(context, "ucml_task_create", llvm::FunctionType::get(
+                bytePointer, {entry->getType(), builder.getInt64Ty()}, false));
+        llvm::Function *start = runtimeFunction(context, "ucml_task_start", llvm::FunctionType::get(
+                voidType, {bytePointer}, false));
+        uint64_t frameSize = context.module->getDataLayout().getTypeAllocSize(frameType);
+        llvm::Value *handle = builder.CreateCall(create, {entry, builder.getInt64(frameSize)}, "task");
+        llvm::Value *frame = builder.CreateBitCast(handle, frameType->getPointerTo(), "frame");
+        for (unsigned i = 0; i < arguments.size(); ++i)
+            builder.CreateStore(arguments[i], builder.CreateStructGEP(frameType, frame, i + 1));
+        builder.CreateCall(start, {handle});
+        context.tasks[handle] = callee->getReturnType();
+        return handle;
+    }
+
+    llvm::Value *FunctionCall::generateJoin(Context &context) {
+        if (!args || args->size() != 1) {
+            FATAL(location, "Function \"join(task)\" requires exactly one argument.");
+            return nullptr;
+        }
+        // Joining frees the task, so a task variable is joined once: not twice, nor in a loop it was not spawned in.
+        if (auto *variable = dynamic_cast<Identifier *>(*args->begin())) {
+            auto *symbol = context.findSymbol(variable->name);
+            auto task = symbol ? context.taskVariables.find(symbol->second) : context.taskVariables.end();
+            if (task != context.taskVariables.end()) {
+                if (task->second.joined) {
+                    FATAL(location, "Task \"" << variable->name << "\" is already joined, a task is joined once.");
+                    return nullptr;
+                }
+                for (Scope *scope = context.getCurrentScope(); scope && scope != task->second.scope;
+                     scope = scope->parent) {
+                    if (!scope->isLoop) continue;
+                    FATAL(location, "Task \"" << variable->name << "\" is joined in a loop it was not spawned in, "
+                                                                 "it would be joined more than once.");
+                    return nullptr;
+                }
+                task->second.joined = true;
+            }
+        }
+        llvm::Value *handle = (*args->begin())->generateCode(context);
+        if (!handle) {
+            FATAL(location, "Invalid argument provided");
+            return nullptr;
+        }
+        llvm::Type *result = taskResult(context, handle);
+        if (!result) {
+            FATAL(location, "\"join()\" takes a task spawned in the same function, e.g. t:task = spawn f(x)");
+            return nullptr;
+        }
+        llvm::IRBuilder<> builder(context.getCurrentBlock());
+        llvm::FunctionType *type = llvm::FunctionType::get(builder.getVoidTy(), {builder.getInt8PtrTy()}, false);
+        builder.CreateCall(runtimeFunction(context, "ucml_task_join", type), {handle});
+        llvm::Value *value = nullptr;
+        if (!result->isVoidTy())
+            value = builder.CreateLoad(builder.CreateBitCast(handle, result->getPointerTo()), "joined");
+        llvm::Value *release = builder.CreateCall(runtimeFunction(context, "ucml_task_free", type), {handle});
+        return value ? value : release;
+    }
+
     llvm::Value *FunctionCall::generateCode(Context &context) {
-        llvm::Function *function = context.module->getFunction(identifier.name);
+        if (isSpawned) {
+            if (identifier.name == "echo" || identifier.name == "join" || Input::isBuiltIn(identifier.name) ||
+                Tools::isValidType(identifier.name)) {
+                FATAL(location, "Cannot spawn \"" << identifier.name << "()\", only functions can run as tasks.");
+                return nullptr;
+            }
+            isSpawned = false;
+            llvm::Value *call = generateCode(context);
+            isSpawned = true;
+            return generateSpawn(context, call);
+        }
+        llvm::Function *function = context.getFunction(identifier.name);
+        if (!function) {
+            auto generic = context.templates.find(identifier.name);
+            if (generic != context.templates.end()) return generateGenericCall(context, *generic->second);
+        }
         bool notFound = false;
         if (!function) {
             // Check if our dummy "echo()" is called!
@@ -313,12 +844,16 @@ namespace ucml {
                         FATAL(location, "Invalid argument provided");
                         return nullptr;
                     }
-                    arguments.push_back(value);
-                    if (value->getType()->getTypeID() == llvm::Type::DoubleTyID) {
-                        function = context.module->getFunction("echodouble");
+                    // Narrow numbers are printed through the widest type of their kind.
+                    if (value->getType()->isFloatingPointTy()) {
+                        function = context.getFunction("echodouble");
                     } else {
-                        function = context.module->getFunction("echoint");
+                        function = context.getFunction("echoint");
                     }
+                    if (function) {
+                        value = Tools::castValue(context, value, function->arg_begin()->getType(), location, true);
+                    }
+                    arguments.push_back(value);
                     if (!function) {
                         FATAL(location, "Cannot call \"echo()\" function; may be a bug.");
                         return nullptr;
@@ -326,12 +861,35 @@ namespace ucml {
                     return llvm::IRBuilder<>(context.getCurrentBlock()).
                             CreateCall(function, llvm::makeArrayRef(arguments));
                 }
+            } else if (Input::isBuiltIn(identifier.name)) {
+                return generateInputCall(context);
+            } else if (identifier.name == "join") {
+                return generateJoin(context);
+            } else if (Tools::isValidType(identifier.name)) {
+                // Explicit conversion, written as a call to the type: i32(x), float(y), int(z).
+                if (!args || args->size() != 1) {
+                    FATAL(location, "Conversion \"" << identifier.name << "(number)\" requires exactly one argument.");
+                    return nullptr;
+                }
+                llvm::Value *value = (*args->begin())->generateCode(context);
+                if (!value) {
+                    FATAL(location, "Invalid argument provided");
+                    return nullptr;
+                }
+                return Tools::castValue(context, value, Tools::typeOf(identifier.name, context.llvmContext), location,
+                                        true);
             } else notFound = true;
         }
         if (notFound) {
             FATAL(location, "Undefined function \"" << identifier.name << "\"");
             return nullptr;
         }
+        if (!consumesGenerator && context.generators.count(identifier.name)) {
+            FATAL(location, "Generator \"" << identifier.name << "\" can only be iterated over: for (x:"
+                                            << context.generators[identifier.name] << " in " << identifier.name
+                                            << "(...)) {...}");
+            return nullptr;
+        }
         std::vector<llvm::Value *> arguments;
         if (args) {
             if (function->arg_size() < args->size()) {
@@ -341,13 +899,14 @@ namespace ucml {
                                     << (args->size() > 1 ? " were" : " was") << " given.");
                 return nullptr;
             }
+            auto parameter = function->arg_begin();
             for (auto &arg : *args) {
                 llvm::Value *value = (*arg).generateCode(context);
                 if (!value) {
                     FATAL(location, "Invalid argument provided");
                     return nullptr;
                 }
-                arguments.push_back(value);
+                arguments.push_back(Tools::castValue(context, value, (parameter++)->getType(), location));
             }
         }
         return llvm::IRBuilder<>(context.getCurrentBlock()).CreateCall(function, llvm::makeArrayRef(arguments));
@@ -362,7 +921,7 @@ namespace ucml {
                 *progressBlock = llvm::BasicBlock::Create(context.llvmContext, "progress", function),
                 *afterBlock = llvm::BasicBlock::Create(context.llvmContext, "after", function);
         llvm::BranchInst::Create(initBlock, context.getCurrentBlock());
-        context.createNewScope(initBlock);
+        context.createNewScope(initBlock)->isLoop = true;
         llvm::Value *declaration = (new VariableDeclaration(name.location, type, name, &from))->generateCode(context);
         if (!declaration) {
             FATAL(name.location, "Invalid declaration given to loop initialization.");
@@ -376,68 +935,159 @@ namespace ucml {
             FATAL(name.location, "Invalid range given to \"for\" loop.");
             return nullptr;
         }
-        if (type.name != "int" || fromValue->getType()->getTypeID() != fromValue->getType()->IntegerTyID ||
-            toValue->getType()->getTypeID() != toValue->getType()->IntegerTyID) {
+        llvm::Type *iteratorType = idValue->getType();
+        if (!iteratorType->isIntegerTy() || !fromValue->getType()->isIntegerTy() ||
+            !toValue->getType()->isIntegerTy()) {
             FATAL(type.location, "Non-integer iterator is not supported yet.");
             return nullptr;
         }
+        fromValue = Tools::castValue(context, fromValue, iteratorType, name.location);
+        toValue = Tools::castValue(context, toValue, iteratorType, name.location);
         llvm::IRBuilder<> builder(context.getCurrentBlock());
         // for(x:int in 1 to 9 by 2)... [upwards]
         // or
         // for(x:int in 9 to 1 by -2)... [downwards]
         // means
         // (x >= from && x <= to || x <= from && x => to)
-        llvm::Value *xGTEFrom = builder.CreateICmpSGE(idValue, fromValue);
-        llvm::Value *xLTTo = builder.CreateICmpSLE(idValue, toValue);
-        llvm::Value *xLEFrom = builder.CreateICmpSLE(idValue, fromValue);
-        llvm::Value *xGTTo = builder.CreateICmpSGE(idValue, toValue);
-        llvm::Value *condition = builder.CreateOr(builder.CreateAnd(xGTEFrom, xLTTo),
-                                                  builder.CreateAnd(xLEFrom, xGTTo));
+        // i.e. x lies in [low, high], checked with a single unsigned compare: (x - low) <= (high - low)
+        llvm::Value *upwards = builder.CreateICmpSLE(fromValue, toValue, "upwards");
+        llvm::Value *low = builder.CreateSelect(upwards, fromValue, toValue, "low");
+        llvm::Value *high = builder.CreateSelect(upwards, toValue, fromValue, "high");
+        llvm::Value *condition = builder.CreateICmpULE(builder.CreateSub(idValue, low),
+                                                       builder.CreateSub(high, low), "inrange");
         llvm::BranchInst::Create(loopBlock, afterBlock, condition, context.getCurrentBlock());
 
         context.setCurrentBlock(loopBlock);
         body.generateCode(context);
         llvm::BranchInst::Create(progressBlock, context.getCurrentBlock());
         context.setCurrentBlock(progressBlock);
-        llvm::Value *increment = builder.getInt64(1);
+        llvm::Value *increment = llvm::ConstantInt::get(iteratorType, 1);
         if (by) {
             increment = by->generateCode(context);
             if (!increment) {
                 FATAL(name.location, "Invalid step given to \"for\" loop.");
                 return nullptr;
             }
-            if (increment->getType()->getTypeID() != fromValue->getType()->IntegerTyID) {
+            if (!increment->getType()->isIntegerTy()) {
                 FATAL(type.location, "Non-integer step in loop is not supported yet.");
                 return nullptr;
             }
+            increment = Tools::castValue(context, increment, iteratorType, name.location);
         }
         builder.SetInsertPoint(context.getCurrentBlock());
         idValue = (new Identifier(name.location, name.name))->generateCode(context);
         llvm::Value *newValue = builder.CreateAdd(idValue, increment);
         builder.CreateStore(newValue, Tools::getValueOfIdentifier(context, name)->second);
-        llvm::BranchInst::Create(conditionBlock, context.getCurrentBlock());
+        llvm::BranchInst *latch = llvm::BranchInst::Create(conditionBlock, context.getCurrentBlock());
+        if (hints) latch->setMetadata(llvm::LLVMContext::MD_loop, getLoopMetadata(context));
+        context.closeCurrentScope();
+        context.setCurrentBlock(afterBlock);
+        return nullptr;
+    }
+
+    llvm::Value *GeneratorLoop::generateCode(Context &context) {
+        auto *call = dynamic_cast<FunctionCall *>(&source);
+        if (!call) {
+            FATAL(location, "A \"for\" loop iterates over a range (from to to) or over a call to a generator.");
+            return nullptr;
+        }
+        call->consumesGenerator = true;
+        llvm::Value *handle = call->generateCode(context);
+        auto *callInst = llvm::dyn_cast_or_null<llvm::CallInst>(handle);
+        auto generator = callInst && callInst->getCalledFunction()
+                         ? context.generators.find(callInst->getCalledFunction()->getName().str())
+                         : context.generators.end();
+        if (generator == context.generators.end()) {
+            FATAL(call->location, "\"" << call->identifier.name << "\" is not a generator, it never yields.");
+            return nullptr;
+        }
+        llvm::Type *elementType = Tools::typeOf(generator->second, context.llvmContext);
+
+        llvm::Function *function = context.getCurrentBlock()->getParent();
+        llvm::BasicBlock
+                *initBlock = llvm::BasicBlock::Create(context.llvmContext, "init", function),
+                *nextBlock = llvm::BasicBlock::Create(context.llvmContext, "next", function),
+                *loopBlock = llvm::BasicBlock::Create(context.llvmContext, "each", function),
+                *afterBlock = llvm::BasicBlock::Create(context.llvmContext, "after", function);
+        llvm::BranchInst::Create(initBlock, context.getCurrentBlock());
+        context.createNewScope(initBlock)->isLoop = true;
+        (new VariableDeclaration(name.location, type, name))->generateCode(context);
+        llvm::BranchInst::Create(nextBlock, context.getCurrentBlock());
+
+        // The generator already ran up to its first "yield" (or to its end) when it was called.
+        llvm::IRBuilder<> builder(nextBlock);
+        builder.CreateCondBr(builder.CreateCall(intrinsic(context, llvm::Intrinsic::coro_done), {handle}, "done"),
+                             afterBlock, loopBlock);
+
+        builder.SetInsertPoint(loopBlock);
+        unsigned alignment = context.module->getDataLayout().getABITypeAlignment(elementType);
+        llvm::Value *promise = builder.CreateCall(intrinsic(context, llvm::Intrinsic::coro_promise),
+                                                  {handle, builder.getInt32(alignment), builder.getFalse()});
+        llvm::Value *value = builder.CreateLoad(builder.CreateBitCast(promise, elementType->getPointerTo()));
+        context.setCurrentBlock(loopBlock);
+        auto variable = Tools::getValueOfIdentifier(context, name);
+        value = Tools::castValue(context, value, variable->first, name.location);
+        new llvm::StoreInst(value, variable->second, context.getCurrentBlock());
+        context.iterated.push_back(handle);
+        body.generateCode(context);
+        context.iterated.pop_back();
+        if (!context.getCurrentBlock()->getTerminator()) {
+            builder.SetInsertPoint(context.getCurrentBlock());
+            builder.CreateCall(intrinsic(context, llvm::Intrinsic::coro_resume), {handle});
+            builder.CreateBr(nextBlock);
+        }
         context.closeCurrentScope();
         context.setCurrentBlock(afterBlock);
+        llvm::IRBuilder<>(afterBlock).CreateCall(intrinsic(context, llvm::Intrinsic::coro_destroy), {handle});
         return nullptr;
     }
 
+    llvm::MDNode *ForLoop::getLoopMetadata(Context &context) {
+        // See "llvm.loop" in the LangRef: a distinct node listing itself first, then one node per hint.
+        llvm::LLVMContext &llvmContext = context.llvmContext;
+        llvm::Type *int32 = llvm::Type::getInt32Ty(llvmContext);
+        auto property = [&](const char *name, llvm::Constant *value) -> llvm::Metadata * {
+            return llvm::MDNode::get(llvmContext, {llvm::MDString::get(llvmContext, name),
+                                                   llvm::ConstantAsMetadata::get(value)});
+        };
+        std::vector<llvm::Metadata *> operands{nullptr};
+        for (auto *hint : *hints) {
+            const std::string &kind = hint->name.name;
+            long long value = hint->value;
+            if (kind == "unroll" && value >= 1) {
+                if (value == 1) operands.push_back(llvm::MDNode::get(
+                            llvmContext, {llvm::MDString::get(llvmContext, "llvm.loop.unroll.disable")}));
+                else operands.push_back(property("llvm.loop.unroll.count", llvm::ConstantInt::get(int32, value)));
+            } else if (kind == "vectorize" && value >= 1 && value <= 64 && !(value & (value - 1))) {
+                operands.push_back(property("llvm.loop.vectorize.width", llvm::ConstantInt::get(int32, value)));
+                operands.push_back(property("llvm.loop.vectorize.enable",
+                                            llvm::ConstantInt::get(llvm::Type::getInt1Ty(llvmContext), value > 1)));
+            } else if (kind == "interleave" && value >= 1 && value <= 16) {
+                operands.push_back(property("llvm.loop.interleave.count", llvm::ConstantInt::get(int32, value)));
+            } else if (kind == "unroll" || kind == "vectorize" || kind == "interleave") {
+                FATAL(hint->name.location, "Invalid value " << value << " for \"" << kind << "\", expected "
+                                           << (kind == "unroll" ? "a positive count." : kind == "vectorize"
+                                               ? "a power of two up to 64." : "a count from 1 to 16."));
+                return nullptr;
+            } else {
+                FATAL(hint->name.location, "Unknown loop hint \"" << kind
+                                           << "\", expected unroll(n), vectorize(n) or interleave(n).");
+                return nullptr;
+            }
+        }
+        ++context.loopHints;
+        llvm::MDNode *loop = llvm::MDNode::getDistinct(llvmContext, operands);
+        loop->replaceOperandWith(0, loop);
+        return loop;
+    }
+
     llvm::Value *IfCondition::generateCode(Context &context) {
         llvm::Value *conditionValue = condition.generateCode(context);
         if (!conditionValue) {
             FATAL(location, "Invalid condition given to \"if\" statement.");
             return nullptr;
         }
-        llvm::IRBuilder<> irBuilder(context.getCurrentBlock());
-        conditionValue = irBuilder.CreateOr(conditionValue, irBuilder.getInt64(0));
-        llvm::Type::TypeID conditionType = conditionValue->getType()->getTypeID();
-
-        if (conditionType == conditionValue->getType()->DoubleTyID) {
-            conditionValue = irBuilder.CreateFCmp(llvm::CmpInst::Predicate::FCMP_ONE, conditionValue,
-                                                  llvm::ConstantFP::get(irBuilder.getDoubleTy(), 0.0));
-        } else if (conditionType == conditionValue->getType()->IntegerTyID) {
-            conditionValue = irBuilder.CreateICmp(llvm::CmpInst::Predicate::ICMP_NE, conditionValue,
-                                                  irBuilder.getInt64(0));
-        }
+        conditionValue = Tools::toCondition(context, conditionValue);
         llvm::Function *function = context.getCurrentBlock()->getParent();
         llvm::BasicBlock
                 *then = llvm::BasicBlock::Create(context.llvmContext, "then", function),
@@ -446,8 +1096,7 @@ namespace ucml {
         llvm::BranchInst::Create(then, otherwise, conditionValue, context.getCurrentBlock());
         context.createNewScope(then);
         thenBlock.generateCode(context);
-        context.getCurrentBlock()->getTerminator() ||
-        llvm::BranchInst::Create(merge, otherwise, conditionValue, context.getCurrentBlock());
+        context.getCurrentBlock()->getTerminator() || llvm::BranchInst::Create(merge, context.getCurrentBlock());
         context.closeCurrentScope();
         context.createNewScope(otherwise);
         if (elseBlock) {
@@ -459,13 +1108,109 @@ namespace ucml {
         return merge;
     }
 
+    llvm::Value *MatchStatement::generateCode(Context &context) {
+        llvm::Value *value = subject.generateCode(context);
+        if (!value || !value->getType()->isIntegerTy()) {
+            FATAL(location, "Only integers can be matched.");
+            return nullptr;
+        }
+        llvm::IntegerType *type = llvm::cast<llvm::IntegerType>(value->getType());
+        // Every label has to be a constant; ranges are spelled out value by value, the code generator turns runs of
+        // them into jump tables, bit tests or range checks, whichever is cheapest.
+        const unsigned long long maxCases = 1u << 16;
+        std::vector<std::vector<llvm::ConstantInt *> > values(arms->size());
+        std::set<long long> matched;
+        int defaultArm = -1;
+        for (size_t i = 0; i < arms->size(); ++i) {
+            MatchArm &arm = *(*arms)[i];
+            for (auto &label : arm.labels) {
+                auto *wildcard = dynamic_cast<Identifier *>(label.first);
+                if (wildcard && wildcard->name == "_" && !label.second) {
+                    if (defaultArm >= 0) {
+                        FATAL(arm.location, "Only one \"_\" case is allowed in a match.");
+                        return nullptr;
+                    }
+                    defaultArm = (int) i;
+                    continue;
+                }
+                llvm::Value *low = label.first->generateCode(context),
+                        *high = label.second ? label.second->generateCode(context) : low;
+                auto *from = llvm::dyn_cast_or_null<llvm::ConstantInt>(low),
+                        *to = llvm::dyn_cast_or_null<llvm::ConstantInt>(high);
+                if (!from || !to) {
+                    FATAL(arm.location, "Case labels must be integer constants.");
+                    return nullptr;
+                }
+                // A label the subject cannot hold would be truncated into some other, unrelated value.
+                for (auto *bound : {from, to}) {
+                    bool fits = Tools::isLiteralOf(bound, type) || (type->isIntegerTy(1) && bound->getValue().ule(1));
+                    if (fits) continue;
+                    FATAL(arm.location, "Case label " << bound->getSExtValue() << " does not fit in the "
+                                                      << Tools::nameOf(type) << " being matched.");
+                    return nullptr;
+                }
+                from = llvm::cast<llvm::ConstantInt>(Tools::castValue(context, from, type, arm.location));
+                to = llvm::cast<llvm::ConstantInt>(Tools::castValue(context, to, type, arm.location));
+                long long first = from->getSExtValue(), last = to->getSExtValue();
+                unsigned long long count = (unsigned long long) last - (unsigned long long) first + 1;
+                if (first > last || count > maxCases - matched.size()) {
+                    FATAL(arm.location, "Invalid range " << first << " to " << last << ", a match handles up to "
+                                                         << maxCases << " values in increasing ranges.");
+                    return nullptr;
+                }
+                for (long long v = first;; ++v) {
+                    if (!matched.insert(v).second) {
+                        FATAL(arm.location, "Value " << v << " is matched more than once.");
+                        return nullptr;
+                    }
+                    values[i].push_back(llvm::ConstantInt::get(type, (uint64_t) v, true));
+                    if (v == last) break;
+                }
+            }
+        }
+
+        llvm::Function *function = context.getCurrentBlock()->getParent();
+        llvm::BasicBlock *after = llvm::BasicBlock::Create(context.llvmContext, "matched", function);
+        llvm::SwitchInst *dispatch = llvm::SwitchInst::Create(value, after, (unsigned) matched.size(),
+                                                              context.getCurrentBlock());
+        for (size_t i = 0; i < arms->size(); ++i) {
+            llvm::BasicBlock *block = llvm::BasicBlock::Create(context.llvmContext, "case", function, after);
+            for (auto *caseValue : values[i]) dispatch->addCase(caseValue, block);
+            if ((int) i == defaultArm) dispatch->setDefaultDest(block);
+            context.createNewScope(block);
+            (*arms)[i]->body->generateCode(context);
+            context.getCurrentBlock()->getTerminator() || llvm::BranchInst::Create(after, context.getCurrentBlock());
+            context.closeCurrentScope();
+        }
+        context.setCurrentBlock(after);
+        return nullptr;
+    }
+
+    llvm::Value *ImportStatement::generateCode(Context &context) {
+        if (context.size() > 1) {
+            FATAL(location, "Libraries can only be imported at the top level.");
+            return nullptr;
+        }
+        std::string error;
+        if (!Library::import(context, identifier.name, true, error)) {
+            FATAL(location, error << ".");
+            return nullptr;
+        }
+        return nullptr;
+    }
+
     llvm::Value *ReturnStatement::generateCode(Context &context) {
-        if (context.getCurrentBlock()->getParent() == context.module->getFunction("main")) {
+        if (context.getCurrentBlock()->getParent() == context.mainFunction) {
             FATAL(location, "Return statement outside a function.");
             return nullptr;
         }
 
-        llvm::Type *returnType = context.getCurrentBlock()->getParent()->getReturnType();
+        llvm::Function *function = context.getCurrentBlock()->getParent();
+        if (context.generator && context.generator->function == function) {
+            FATAL(location, "Generators cannot return a value, they \"yield\" them.");
+            return nullptr;
+        }
+        llvm::Type *returnType = function->getReturnType();
         llvm::Value *value = expression->generateCode(context);
         if (expression) {
             if (returnType->getTypeID() == llvm::Type::VoidTyID) {
@@ -476,17 +1221,49 @@ namespace ucml {
                 FATAL(location, "Invalid return value.");
                 return nullptr;
             }
-            llvm::IRBuilder<> builder(context.getCurrentBlock());
-            if (returnType->getTypeID() == llvm::Type::IntegerTyID &&
-                value->getType()->getTypeID() == llvm::Type::DoubleTyID) {
-                W(location, "Truncating double to fit integer return type.");
-                value = builder.CreateFPToSI(value, returnType);
-            } else if (returnType->getTypeID() == llvm::Type::DoubleTyID &&
-                       value->getType()->getTypeID() == llvm::Type::IntegerTyID) {
-                W(location, "Converting integer to fit double return type.");
-                value = builder.CreateSIToFP(value, returnType);
-            }
-            return llvm::IRBuilder<>(context.getCurrentBlock()).CreateRet(value);
-        } else return llvm::IRBuilder<>(context.getCurrentBlock()).CreateRetVoid();
+            value = Tools::castValue(context, value, returnType, location);
+        }
+        llvm::IRBuilder<> builder(context.getCurrentBlock());
+        // Leaving loops over generators early, nothing is going to resume them again.
+        for (auto *handle : iteratedIn(context, function)) {
+            builder.CreateCall(intrinsic(context, llvm::Intrinsic::coro_destroy), {handle});
+        }
+        return expression ? builder.CreateRet(value) : builder.CreateRetVoid();
+    }
+
+    llvm::Value *YieldStatement::generateCode(Context &context) {
+        llvm::Function *function = context.getCurrentBlock()->getParent();
+        Generator *generator = context.generator;
+        if (!generator || generator->function != function) {
+            FATAL(location, "\"yield\" outside a generator function.");
+            return nullptr;
+        }
+        llvm::Value *value = expression.generateCode(context);
+        if (!value) {
+            FATAL(location, "Invalid value given to \"yield\".");
+            return nullptr;
+        }
+        value = Tools::castValue(context, value, llvm::cast<llvm::AllocaInst>(generator->promise)->getAllocatedType(),
+                                 location);
+        llvm::IRBuilder<> builder(context.getCurrentBlock());
+        builder.CreateStore(value, generator->promise);
+        llvm::Value *state = builder.CreateCall(intrinsic(context, llvm::Intrinsic::coro_suspend),
+                                                {llvm::ConstantTokenNone::get(context.llvmContext),
+                                                 builder.getFalse()}, "state");
+        llvm::BasicBlock *resume = llvm::BasicBlock::Create(context.llvmContext, "resume", function),
+                *cleanup = generator->cleanup;
+        // Destroyed while suspended here, inside loops over other generators: those go first.
+        std::vector<llvm::Value *> handles = iteratedIn(context, function);
+        if (!handles.empty()) {
+            cleanup = llvm::BasicBlock::Create(context.llvmContext, "unwind", function);
+            llvm::IRBuilder<> unwind(cleanup);
+            for (auto *handle : handles) unwind.CreateCall(intrinsic(context, llvm::Intrinsic::coro_destroy), {handle});
+            unwind.CreateBr(generator->cleanup);
+        }
+        llvm::SwitchInst *dispatch = builder.CreateSwitch(state, generator->suspend, 2);
+        dispatch->addCase(builder.getInt8(0), resume);
+        dispatch->addCase(builder.getInt8(1), cleanup);
+        context.setCurrentBlock(resume);
+        return value;
     }
 }
@@ -16,6 +16,7 @@
 #ifndef UCML_NODES_H
 #define UCML_NODES_H
 
+#include <map>
 #include <vector>
 #include <llvm/IR/Value.h>
 #include <llvm/IR/Module.h>
@@ -72,10 +73,12 @@ namespace ucml {
     typedef std::vector<Statement *> StatementList;
     typedef std::vector<Expression *> ExpressionList;
     typedef std::vector<VariableDeclaration *> VariableList;
+    typedef std::vector<Identifier *> IdentifierList;
 
     class Block : public Node {
     public:
         StatementList statements;
+        std::vector<YYLTYPE> locations; // Source location of each statement, for debug line tables.
 
         llvm::Value *generateCode(Context &context) override;
     };
@@ -108,6 +111,15 @@ namespace ucml {
         llvm::Value *generateCode(Context &context) override;
     };
 
+    class Boolean : public Expression {
+    public:
+        bool value;
+
+        explicit Boolean(bool value);
+
+        llvm::Value *generateCode(Context &context) override;
+    };
+
     class BinaryOperation : public Expression {
     public:
         YYLTYPE location;
@@ -116,6 +128,22 @@ namespace ucml {
 
         BinaryOperation(YYLTYPE location, int op, Expression &lhs, Expression &rhs);
 
+        // Generates the right operand and applies the operation to it and the already generated left one.
+        llvm::Value *apply(Context &context, llvm::Value *leftValue);
+
+        llvm::Value *generateCode(Context &context) override;
+    };
+
+    class LogicalOperation : public Expression {
+    public:
+        YYLTYPE location;
+        int operation;
+        Expression &left, &right;
+
+        LogicalOperation(YYLTYPE location, int op, Expression &lhs, Expression &rhs);
+
+        llvm::Value *apply(Context &context, llvm::Value *leftValue);
+
         llvm::Value *generateCode(Context &context) override;
     };
 
@@ -148,9 +176,20 @@ namespace ucml {
         Block *body;
         VariableList *parameters;
         bool isExternal;
+        IdentifierList *typeParameters;
 
         FunctionDeclaration(YYLTYPE location, const Identifier &type, const Identifier &name, Block *body = nullptr,
-                            VariableList *params = nullptr, bool isExt = false);
+                            VariableList *params = nullptr, bool isExt = false, IdentifierList *typeParams = nullptr);
+
+        llvm::FunctionType *getFunctionType(Context &context);
+
+        bool isTypeParameter(const std::string &typeName) const;
+
+        bool isGenerator() const;
+
+        llvm::Function *instantiate(Context &context, const std::map<std::string, std::string> &typeArguments);
+
+        llvm::Function *generateFunction(Context &context, const std::string &name);
 
         llvm::Value *generateCode(Context &context) override;
     };
@@ -160,12 +199,34 @@ namespace ucml {
         YYLTYPE location;
         const Identifier &identifier;
         ExpressionList *args;
+        bool consumesGenerator; // Set by the "for" loop iterating over it, the only place a generator may be called.
+        bool isSpawned;         // "spawn f(x)": run the call as a task, see ucml::Scheduler.
+
+        explicit FunctionCall(YYLTYPE location, const Identifier &name, ExpressionList *args = nullptr,
+                              bool isSpawned = false);
 
-        explicit FunctionCall(YYLTYPE location, const Identifier &name, ExpressionList *args = nullptr);
+        llvm::Value *generateGenericCall(Context &context, FunctionDeclaration &generic);
+
+        llvm::Value *generateInputCall(Context &context);
+
+        llvm::Value *generateSpawn(Context &context, llvm::Value *call);
+
+        llvm::Value *generateJoin(Context &context);
 
         llvm::Value *generateCode(Context &context) override;
     };
 
+    // One of "unroll(n)", "vectorize(n)" or "interleave(n)" after the header of a for loop.
+    class LoopHint {
+    public:
+        const Identifier &name;
+        long long value;
+
+        LoopHint(const Identifier &name, long long value);
+    };
+
+    typedef std::vector<LoopHint *> LoopHintList;
+
     class ForLoop : public Statement {
     public:
         Identifier &name;
@@ -173,9 +234,25 @@ namespace ucml {
         Expression &from, &to;
         Block &body;
         Expression *by;
+        LoopHintList *hints;
 
         ForLoop(Identifier &varName, const Identifier &type, Expression &from, Expression &to, Block &body,
-                Expression *by = nullptr);
+                Expression *by = nullptr, LoopHintList *hints = nullptr);
+
+        llvm::MDNode *getLoopMetadata(Context &context);
+
+        llvm::Value *generateCode(Context &context) override;
+    };
+
+    class GeneratorLoop : public Statement {
+    public:
+        YYLTYPE location;
+        Identifier &name;
+        const Identifier &type;
+        Expression &source;
+        Block &body;
+
+        GeneratorLoop(YYLTYPE location, Identifier &varName, const Identifier &type, Expression &source, Block &body);
 
         llvm::Value *generateCode(Context &context) override;
     };
@@ -191,6 +268,37 @@ namespace ucml {
         llvm::Value *generateCode(Context &context) override;
     };
 
+    // One "labels => {...}" of a match; every label is a value, a range "from to to" (second is set) or "_".
+    class MatchArm {
+    public:
+        YYLTYPE location;
+        std::vector<std::pair<Expression *, Expression *> > labels;
+        Block *body{nullptr};
+    };
+
+    typedef std::vector<MatchArm *> MatchArmList;
+
+    class MatchStatement : public Statement {
+    public:
+        YYLTYPE location;
+        Expression &subject;
+        MatchArmList *arms;
+
+        MatchStatement(YYLTYPE location, Expression &subject, MatchArmList *arms);
+
+        llvm::Value *generateCode(Context &context) override;
+    };
+
+    class ImportStatement : public Statement {
+    public:
+        YYLTYPE location;
+        const Identifier &identifier;
+
+        ImportStatement(YYLTYPE location, const Identifier &name);
+
+        llvm::Value *generateCode(Context &context) override;
+    };
+
     class ReturnStatement : public Statement {
     public:
         YYLTYPE location;
@@ -200,5 +308,15 @@ namespace ucml {
 
         llvm::Value *generateCode(Context &context) override;
     };
+
+    class YieldStatement : public Statement {
+    public:
+        YYLTYPE location;
+        Expression &expression;
+
+        YieldStatement(YYLTYPE location, Expression &expr);
+
+        llvm::Value *generateCode(Context &context) override;
+    };
 }
 #endif
@@ -20,6 +20,9 @@
     
     extern void yyerror(const char* msg);
     extern int yylex();
+
+    // Nesting levels the parser accepts (10000 by default); the compiler runs on a stack deep enough for them.
+    #define YYMAXDEPTH 200000
 %}
 
 %code requires {
@@ -39,6 +42,10 @@
     ucml::Identifier            *id;
     ucml::VariableList          *varList;
     ucml::ExpressionList        *exprList;
+    ucml::IdentifierList        *idList;
+    ucml::MatchArm              *arm;
+    ucml::MatchArmList          *arms;
+    ucml::LoopHintList          *hints;
     ucml::VariableDeclaration   *var_decl;
 }
 
@@ -47,7 +54,7 @@
 %precedence LOW
 
 %token<string>  INTEGER DOUBLE ID
-%token<token>   IF ELSE FOR IN TO BY DEF RETURN EXTERN LAMBDA EQ NE LT GT LE GE
+%token<token>   IF ELSE FOR IN TO BY DEF RETURN YIELD MATCH SPAWN EXTERN IMPORT LAMBDA EQ NE LT GT LE GE AND OR TRUE FALSE
 
 %type<id>       id
 %type<block>    program stmts block
@@ -55,8 +62,14 @@
 %type<expr>     expr numeric arithmetic comparision
 %type<varList>  func_decl_args
 %type<exprList> call_args
+%type<idList>   type_params
+%type<arm>      match_arm match_labels
+%type<arms>     match_arms
+%type<hints>    loop_hints
 %type<var_decl> var_decl
 
+%left OR
+%left AND
 %left EQ NE LT GT LE GE
 %left '+' '-'
 %left '*' '/' '%'
@@ -74,8 +87,9 @@ program: stmts                                              {mainBlock = $1;}
     | %empty                                                {mainBlock = new ucml::Block();}
     ;
 
-stmts: stmt                                                 {$$ = new ucml::Block(); $$->statements.push_back($1);}
-    | stmts stmt                                            {$1->statements.push_back($2);}
+stmts: stmt                                                 {$$ = new ucml::Block(); $$->statements.push_back($1);
+                                                             $$->locations.push_back(@1);}
+    | stmts stmt                                            {$1->statements.push_back($2); $1->locations.push_back(@2);}
     ;
 
 stmt: var_decl                                              {$$ = $1;}
@@ -84,9 +98,33 @@ stmt: var_decl                                              {$$ = $1;}
     | expr %prec LOW                                        {$$ = new ucml::ExprStatement(*$1);}
     | IF '(' expr ')' block                                 {$$ = new ucml::IfCondition(@$, *$3, *$5);}
     | IF '(' expr ')' block ELSE block                      {$$ = new ucml::IfCondition(@$, *$3, *$5, $7);}
-    | FOR '(' id ':' id IN expr TO expr ')' block           {$$ = new ucml::ForLoop(*$3, *$5, *$7, *$9, *$11);}
-    | FOR '(' id ':' id IN expr TO expr BY expr ')' block   {$$ = new ucml::ForLoop(*$3, *$5, *$7, *$9, *$13, $11);}
+    | FOR '(' id ':' id IN expr TO expr ')' loop_hints block
+                                                            {$$ = new ucml::ForLoop(*$3, *$5, *$7, *$9, *$12, nullptr, $11);}
+    | FOR '(' id ':' id IN expr TO expr BY expr ')' loop_hints block
+                                                            {$$ = new ucml::ForLoop(*$3, *$5, *$7, *$9, *$14, $11, $13);}
+    | FOR '(' id ':' id IN expr ')' block                   {$$ = new ucml::GeneratorLoop(@$, *$3, *$5, *$7, *$9);}
     | RETURN expr %prec LOW                                 {$$ = new ucml::ReturnStatement(@$, $2);}
+    | YIELD expr %prec LOW                                  {$$ = new ucml::YieldStatement(@$, *$2);}
+    | IMPORT id                                             {$$ = new ucml::ImportStatement(@$, *$2);}
+    | MATCH '(' expr ')' '{' match_arms '}'                 {$$ = new ucml::MatchStatement(@$, *$3, $6);}
+    ;
+
+loop_hints: %empty                                          {$$ = nullptr;}
+    | loop_hints id '(' INTEGER ')'                         {$$ = $1 ? $1 : new ucml::LoopHintList();
+                                                             $$->push_back(new ucml::LoopHint(*$2, atol($4->c_str())));}
+    ;
+
+match_arms: match_arm                                       {$$ = new ucml::MatchArmList(); $$->push_back($1);}
+    | match_arms match_arm                                  {$1->push_back($2);}
+    ;
+
+match_arm: match_labels LAMBDA block                        {$$ = $1; $$->location = @1; $$->body = $3;}
+    ;
+
+match_labels: expr                                          {$$ = new ucml::MatchArm(); $$->labels.emplace_back($1, nullptr);}
+    | expr TO expr                                          {$$ = new ucml::MatchArm(); $$->labels.emplace_back($1, $3);}
+    | match_labels ',' expr                                 {$1->labels.emplace_back($3, nullptr);}
+    | match_labels ',' expr TO expr                         {$1->labels.emplace_back($3, $5);}
     ;
 
 var_decl: id ':' id                                         {$$ = new ucml::VariableDeclaration(@$, *$3, *$1);}
@@ -95,6 +133,9 @@ var_decl: id ':' id                                         {$$ = new ucml::Vari
 
 func_decl:  DEF id '(' ')' ':' id LAMBDA block              {$$ = new ucml::FunctionDeclaration(@$, *$6, *$2, $8);}
     | DEF id '(' func_decl_args ')' ':' id LAMBDA block     {$$ = new ucml::FunctionDeclaration(@$, *$7, *$2, $9, $4);}
+    | DEF id LT type_params GT '(' ')' ':' id LAMBDA block  {$$ = new ucml::FunctionDeclaration(@$, *$9, *$2, $11, nullptr, false, $4);}
+    | DEF id LT type_params GT '(' func_decl_args ')' ':' id LAMBDA block
+                                                            {$$ = new ucml::FunctionDeclaration(@$, *$10, *$2, $12, $7, false, $4);}
     ;
 
 extern_decl: EXTERN id '(' ')' ':' id                       {$$ = new ucml::FunctionDeclaration(@$, *$6, *$2, nullptr, nullptr, true);}
@@ -105,11 +146,18 @@ expr: id %prec LOW                                          {$$ = $1;}
     | id '=' expr %prec LOW                                 {$$ = new ucml::Assignment(@$, *$1, *$3);}
     | id '(' ')'                                            {$$ = new ucml::FunctionCall(@$, *$1);}
     | id '(' call_args ')'                                  {$$ = new ucml::FunctionCall(@$, *$1, $3);}
+    | SPAWN id '(' ')'                                      {$$ = new ucml::FunctionCall(@$, *$2, nullptr, true);}
+    | SPAWN id '(' call_args ')'                            {$$ = new ucml::FunctionCall(@$, *$2, $4, true);}
     | '(' expr ')'                                          {$$ = $2;}
     | numeric                                               {$$ = $1;}
     | arithmetic                                            {$$ = $1;}
     | comparision                                           {$$ = $1;}
     | '-' expr %prec HIGH                                   {$$ = new ucml::UnaryOperation(@$, '-', *$2);}
+    | '!' expr %prec HIGH                                   {$$ = new ucml::UnaryOperation(@$, '!', *$2);}
+    | expr AND expr                                         {$$ = new ucml::LogicalOperation(@$, AND, *$1, *$3);}
+    | expr OR expr                                          {$$ = new ucml::LogicalOperation(@$, OR, *$1, *$3);}
+    | TRUE                                                  {$$ = new ucml::Boolean(true);}
+    | FALSE                                                 {$$ = new ucml::Boolean(false);}
     ;
 
 block: '{' '}'                                              {$$ = new ucml::Block();}
@@ -122,6 +170,10 @@ func_decl_args: var_decl                                    {$$ = new ucml::Vari
     | func_decl_args ',' var_decl                           {$1->push_back($3);}
     ;
 
+type_params: id                                             {$$ = new ucml::IdentifierList(); $$->push_back($1);}
+    | type_params ',' id                                    {$1->push_back($3);}
+    ;
+
 call_args: expr                                             {$$ = new ucml::ExpressionList(); $$->push_back($1);}
     | call_args ',' expr                                    {$1->push_back($3);}
     ;
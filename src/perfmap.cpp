@@ -0,0 +1,53 @@
+/*
+   Copyright 2019 Atikur Rahman Chitholian
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+#include <string>
+#include <unistd.h>
+#include <llvm/Object/SymbolSize.h>
+#include "perfmap.hpp"
+
+namespace ucml {
+    PerfMapListener::PerfMapListener() {
+        file = fopen(("/tmp/perf-" + std::to_string(getpid()) + ".map").c_str(), "w");
+    }
+
+    PerfMapListener::~PerfMapListener() {
+        if (file) fclose(file);
+    }
+
+    void PerfMapListener::notifyObjectLoaded(ObjectKey key, const llvm::object::ObjectFile &object,
+                                             const llvm::RuntimeDyld::LoadedObjectInfo &info) {
+        if (!file) return;
+        // The debug copy of the object carries the final load addresses of its sections.
+        llvm::object::OwningBinary<llvm::object::ObjectFile> debugObject = info.getObjectForDebug(object);
+        if (!debugObject.getBinary()) return;
+        for (auto &symbolSize : llvm::object::computeSymbolSizes(*debugObject.getBinary())) {
+            llvm::object::SymbolRef symbol = symbolSize.first;
+            auto type = symbol.getType();
+            auto name = symbol.getName();
+            auto address = symbol.getAddress();
+            if (!type || !name || !address) {
+                if (!type) llvm::consumeError(type.takeError());
+                if (!name) llvm::consumeError(name.takeError());
+                if (!address) llvm::consumeError(address.takeError());
+                continue;
+            }
+            if (*type != llvm::object::SymbolRef::ST_Function || !symbolSize.second) continue;
+            fprintf(file, "%llx %llx %s\n", (unsigned long long) *address, (unsigned long long) symbolSize.second,
+                    name->str().c_str());
+        }
+        fflush(file);
+    }
+}
@@ -0,0 +1,39 @@
+/*
+   Copyright 2019 Atikur Rahman Chitholian
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+#ifndef UCML_PERFMAP_H
+#define UCML_PERFMAP_H
+
+#include <cstdio>
+#include <llvm/ExecutionEngine/JITEventListener.h>
+
+namespace ucml {
+    /**
+     * Writes "/tmp/perf-<pid>.map" so "perf report" can name JIT'd functions even when LLVM was built without its
+     * own jitdump listener.
+     */
+    class PerfMapListener : public llvm::JITEventListener {
+        FILE *file;
+    public:
+        PerfMapListener();
+
+        ~PerfMapListener() override;
+
+        void notifyObjectLoaded(ObjectKey key, const llvm::object::ObjectFile &object,
+                                const llvm::RuntimeDyld::LoadedObjectInfo &info) override;
+    };
+}
+
+#endif
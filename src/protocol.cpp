@@ -0,0 +1,121 @@
+/*
+   Copyright 2019 Atikur Rahman Chitholian
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <cerrno>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include "protocol.hpp"
+
+namespace ucml {
+    std::string Protocol::socketPath() {
+        const char *path = getenv("UCML_SOCKET");
+        if (path && *path) return path;
+        path = getenv("XDG_RUNTIME_DIR");
+        if (path && *path) return std::string(path) + "/ucml.sock";
+        // /tmp is shared, so keep the socket in a private directory and refuse one planted by another user.
+        std::string directory = "/tmp/ucml-" + std::to_string(getuid());
+        if (mkdir(directory.c_str(), 0700) && errno != EEXIST) return "";
+        struct stat status{};
+        if (lstat(directory.c_str(), &status) || !S_ISDIR(status.st_mode) || status.st_uid != getuid() ||
+            (status.st_mode & 0077))
+            return "";
+        return directory + "/ucml.sock";
+    }
+
+    bool Protocol::isSameUser(int socket) {
+        struct ucred credentials{};
+        socklen_t size = sizeof(credentials);
+        if (getsockopt(socket, SOL_SOCKET, SO_PEERCRED, &credentials, &size) || size != sizeof(credentials))
+            return false;
+        return credentials.uid == getuid();
+    }
+
+    bool Protocol::sendRequest(int socket, const std::vector<std::string> &strings) {
+        std::string payload;
+        for (auto &string : strings) payload.append(string.c_str(), string.size() + 1);
+        uint32_t size = (uint32_t) payload.size();
+
+        int descriptors[3] = {STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO};
+        char control[CMSG_SPACE(sizeof(descriptors))];
+        memset(control, 0, sizeof(control));
+        struct iovec vector{&size, sizeof(size)};
+        struct msghdr message{};
+        message.msg_iov = &vector;
+        message.msg_iovlen = 1;
+        message.msg_control = control;
+        message.msg_controllen = sizeof(control);
+        struct cmsghdr *header = CMSG_FIRSTHDR(&message);
+        header->cmsg_level = SOL_SOCKET;
+        header->cmsg_type = SCM_RIGHTS;
+        header->cmsg_len = CMSG_LEN(sizeof(descriptors));
+        memcpy(CMSG_DATA(header), descriptors, sizeof(descriptors));
+        if (sendmsg(socket, &message, 0) != sizeof(size)) return false;
+        return writeFully(socket, payload.data(), payload.size());
+    }
+
+    bool Protocol::receiveRequest(int socket, std::vector<std::string> &strings, int descriptors[3]) {
+        uint32_t size = 0;
+        char control[CMSG_SPACE(3 * sizeof(int))];
+        struct iovec vector{&size, sizeof(size)};
+        struct msghdr message{};
+        message.msg_iov = &vector;
+        message.msg_iovlen = 1;
+        message.msg_control = control;
+        message.msg_controllen = sizeof(control);
+        if (recvmsg(socket, &message, 0) != sizeof(size)) return false;
+        struct cmsghdr *header = CMSG_FIRSTHDR(&message);
+        if (!header || header->cmsg_type != SCM_RIGHTS || header->cmsg_len != CMSG_LEN(3 * sizeof(int))) return false;
+        memcpy(descriptors, CMSG_DATA(header), 3 * sizeof(int));
+
+        std::string payload(size, '\0');
+        if (!readFully(socket, &payload[0], size)) return false;
+        strings.clear();
+        for (size_t begin = 0; begin < payload.size();) {
+            size_t end = payload.find('\0', begin);
+            if (end == std::string::npos) return false;
+            strings.push_back(payload.substr(begin, end - begin));
+            begin = end + 1;
+        }
+        return true;
+    }
+
+    bool Protocol::readFully(int descriptor, void *buffer, size_t size) {
+        auto *bytes = (char *) buffer;
+        while (size) {
+            ssize_t count = read(descriptor, bytes, size);
+            if (count < 0 && errno == EINTR) continue;
+            if (count <= 0) return false;
+            bytes += count;
+            size -= (size_t) count;
+        }
+        return true;
+    }
+
+    bool Protocol::writeFully(int descriptor, const void *buffer, size_t size) {
+        auto *bytes = (const char *) buffer;
+        while (size) {
+            ssize_t count = write(descriptor, bytes, size);
+            if (count < 0 && errno == EINTR) continue;
+            if (count <= 0) return false;
+            bytes += count;
+            size -= (size_t) count;
+        }
+        return true;
+    }
+}
@@ -0,0 +1,51 @@
+/*
+   Copyright 2019 Atikur Rahman Chitholian
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+#ifndef UCML_PROTOCOL_H
+#define UCML_PROTOCOL_H
+
+#include <string>
+#include <vector>
+
+namespace ucml {
+    /**
+     * Wire format between the thin client and the daemon over a Unix domain socket. It is kept free of LLVM so the
+     * client stays small and starts instantly.
+     *
+     *     request:  the client's stdin, stdout and stderr (SCM_RIGHTS) along with a 4-byte length, followed by that
+     *               many bytes: the working directory and the command line arguments, each terminated by '\0'
+     *     response: the 4-byte exit status of the command
+     *
+     * The command runs with the client's own descriptors, so its output goes exactly where it would have gone had
+     * the client run the compiler itself. Both ends check with SO_PEERCRED that the other runs as the same user, and
+     * the default socket lives in a directory only that user can enter.
+     */
+    class Protocol {
+    public:
+        static std::string socketPath();
+
+        static bool isSameUser(int socket);
+
+        static bool sendRequest(int socket, const std::vector<std::string> &strings);
+
+        static bool receiveRequest(int socket, std::vector<std::string> &strings, int descriptors[3]);
+
+        static bool readFully(int descriptor, void *buffer, size_t size);
+
+        static bool writeFully(int descriptor, const void *buffer, size_t size);
+    };
+}
+
+#endif
@@ -0,0 +1,80 @@
+/*
+   Copyright 2019 Atikur Rahman Chitholian
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+#include <cstdio>
+#include <iostream>
+#include "repl.hpp"
+
+namespace ucml {
+    Repl::Repl(Context &context, Tools &tools) : context(context), tools(tools), inputCount(0) {}
+
+    int Repl::run() {
+        Tools::recoverErrors = true;
+        // Built-in functions live in the very first module of the session, later inputs only declare them.
+        tools.createBuiltInFunctions();
+        tools.addToSession();
+
+        std::cout << "uCML interactive mode, type \":quit\" or press Ctrl+D to leave.\n";
+        std::string source, line;
+        int depth = 0;
+        while (true) {
+            std::cout << (source.empty() ? "ucml> " : "....> ") << std::flush;
+            if (!std::getline(std::cin, line)) break;
+            if (source.empty() && (line == ":quit" || line == ":q")) break;
+            for (char c : line) {
+                if (c == '{' || c == '(') ++depth;
+                else if (c == '}' || c == ')') --depth;
+            }
+            source += line + "\n";
+            if (depth > 0) continue; // Keep reading until blocks and argument lists are closed.
+            evaluate(source);
+            source.clear();
+            depth = 0;
+        }
+        std::cout << "\n";
+        return 0;
+    }
+
+    bool Repl::evaluate(const std::string &source) {
+        std::string name = "__repl_" + std::to_string(++inputCount);
+        llvm::Function *function;
+        bool started = false;
+        try {
+            Block *block = Tools::parseSource(source);
+            if (!block) return false;
+
+            context.startModule(name);
+            started = true;
+            tools.prepareModule();
+            tools.setCodeBlock(block);
+            function = tools.generateCode(name);
+            tools.optimize(function);
+            tools.linkLibraries();
+        } catch (CompileError &) {
+            // Whatever was half generated goes away with the module.
+            context.generator = nullptr;
+            context.iterated.clear();
+            if (started) {
+                // Throw the half-built module away, nothing of it has reached the JIT yet.
+                delete context.module;
+                context.startModule(name);
+            }
+            return false;
+        }
+        tools.runIncremental(function);
+        fflush(stdout);
+        return true;
+    }
+}
@@ -0,0 +1,40 @@
+/*
+   Copyright 2019 Atikur Rahman Chitholian
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+#ifndef UCML_REPL_H
+#define UCML_REPL_H
+
+#include <string>
+#include "tools.hpp"
+
+namespace ucml {
+    /**
+     * Read-Eval-Print-Loop: every input is compiled into its own small module and added to one long running JIT
+     * session, so previously defined functions and globals are never compiled again.
+     */
+    class Repl {
+        Context &context;
+        Tools &tools;
+        unsigned inputCount;
+    public:
+        Repl(Context &context, Tools &tools);
+
+        int run();
+
+        bool evaluate(const std::string &source);
+    };
+}
+
+#endif
@@ -0,0 +1,36 @@
+#!/usr/bin/env sh
+
+PROGRAM=$1
+BATCH_D=$2
+LLVMCONFIG=${LLVMCONFIG:-llvm-config}
+CXX=${CXX:-g++}
+
+
+show_usage() {
+    printf "Usage: $0 PROGRAM BATCH-DIR\n\
+    PROGRAM: The executable file.\n\
+    BATCH-DIR: Directory containing score.ml and its host program host.cpp.\n\
+
+    Example: $0 ./uCML ../benchmarks/batch\n\n";
+}
+
+
+if [ "$PROGRAM" = "" ];then
+    echo "Error! Executable not provided.";
+    show_usage;
+    exit 1;
+fi
+if [ "$BATCH_D" = "" ];then
+    echo "Error! Batch benchmark directory not provided.";
+    show_usage;
+    exit 2;
+fi
+
+# The library build emits score_batch(); compile its bitcode and link it into the host.
+"./$PROGRAM" -O3 --emit-lib "$BATCH_D/score.ml" > /dev/null || exit 3
+"$($LLVMCONFIG --bindir)/llc" -O3 -relocation-model=pic -filetype=obj "$BATCH_D/score.bc" -o "$BATCH_D/score.o" || exit 3
+"$CXX" -O2 -std=c++11 "$BATCH_D/host.cpp" "$BATCH_D/score.o" -o "$BATCH_D/host" || exit 3
+"$BATCH_D/host"
+RET=$?
+rm -f "$BATCH_D/score.o" "$BATCH_D/host"
+exit $RET
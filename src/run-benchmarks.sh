@@ -0,0 +1,32 @@
+#!/usr/bin/env sh
+
+PROGRAM=$1
+BENCH_D=$2
+shift 2
+
+
+show_usage() {
+    printf "Usage: $0 PROGRAM BENCH-DIR [OPTIONS]\n\
+    PROGRAM: The executable file.\n\
+    BENCH-DIR: Directory containing uCML benchmarks with .ml extension.\n\
+    OPTIONS: Extra options passed to the executable, -O3 is always given.\n\
+
+    Example: $0 ./uCML ../benchmarks -mcpu=native\n\n";
+}
+
+
+if [ "$PROGRAM" = "" ];then
+    echo "Error! Executable not provided.";
+    show_usage;
+    exit 1;
+fi
+if [ "$BENCH_D" = "" ];then
+    echo "Error! Benchmark-files directory not provided.";
+    show_usage;
+    exit 2;
+fi
+
+for f in "$BENCH_D/"*.ml;do
+    printf "%-40s" "$(basename "$f")"
+    "./$PROGRAM" -O3 "$@" "$f" 2>&1 | grep "Execution completed" | sed 's/====> Execution completed in //'
+done
@@ -0,0 +1,47 @@
+#!/usr/bin/env sh
+
+PROGRAM=$1
+INPUT_D=$2
+ROWS=${3:-10000000}
+
+
+show_usage() {
+    printf "Usage: $0 PROGRAM INPUT-DIR [ROWS]\n\
+    PROGRAM: The executable file.\n\
+    INPUT-DIR: Directory containing the input benchmarks (sum_ints.ml, sum_doubles.ml, sum_column.ml).\n\
+    ROWS: Numbers in every generated input file, default 10000000.\n\
+
+    Example: $0 ./uCML ../benchmarks/input\n\n";
+}
+
+
+if [ "$PROGRAM" = "" ];then
+    echo "Error! Executable not provided.";
+    show_usage;
+    exit 1;
+fi
+if [ "$INPUT_D" = "" ];then
+    echo "Error! Input benchmarks directory not provided.";
+    show_usage;
+    exit 2;
+fi
+
+DATA=$(mktemp -d)
+trap 'rm -rf "$DATA"' EXIT
+seq 1 "$ROWS" > "$DATA/ints.txt"
+awk -v n="$ROWS" 'BEGIN { for (i = 1; i <= n; i++) printf "%.4f\n", i / 7 }' > "$DATA/doubles.txt"
+head -c $((ROWS * 8)) /dev/urandom > "$DATA/column.bin"
+
+# Prints the rows per second of one run, not counting compilation.
+measure() {
+    LABEL=$1
+    shift
+    MS=$("./$PROGRAM" -O3 "$@" 2>&1 | grep "Execution completed" | sed 's/[^0-9]//g')
+    printf "%-40s%s rows/s\n" "$LABEL" "$((ROWS * 1000 / (MS > 0 ? MS : 1)))"
+}
+
+measure "text int, mapped file" --input="$DATA/ints.txt" "$INPUT_D/sum_ints.ml"
+measure "text int, stdin redirected" --input=/dev/stdin "$INPUT_D/sum_ints.ml" < "$DATA/ints.txt"
+cat "$DATA/ints.txt" | measure "text int, stdin piped" --input=/dev/stdin "$INPUT_D/sum_ints.ml"
+measure "text double, mapped file" --input="$DATA/doubles.txt" "$INPUT_D/sum_doubles.ml"
+measure "binary int column, mapped file" --input="$DATA/column.bin" "$INPUT_D/sum_column.ml"
@@ -0,0 +1,34 @@
+#!/usr/bin/env sh
+
+PROGRAM=$1
+BENCH_F=$2
+
+
+show_usage() {
+    printf "Usage: $0 PROGRAM BENCH-FILE\n\
+    PROGRAM: The executable file.\n\
+    BENCH-FILE: uCML program to run on 1, 2, 4, ... threads (up to the number of cores) at once.\n\
+
+    Example: $0 ./uCML ../benchmarks/scaling.ml\n\n";
+}
+
+
+if [ "$PROGRAM" = "" ];then
+    echo "Error! Executable not provided.";
+    show_usage;
+    exit 1;
+fi
+if [ "$BENCH_F" = "" ];then
+    echo "Error! Benchmark file not provided.";
+    show_usage;
+    exit 2;
+fi
+
+CORES=$(nproc)
+THREADS=1
+while [ "$THREADS" -le "$CORES" ];do
+    MS=$("./$PROGRAM" -O3 --threads=$THREADS "$BENCH_F" 2>&1 | grep "concurrent run" | sed 's/.* in \([0-9]*\) ms.*/\1/')
+    # Perfect scaling keeps the time flat, so runs per second grow with the thread count.
+    awk -v t="$THREADS" -v ms="$MS" 'BEGIN { printf "%4d thread(s): %8d ms, %8.2f runs/s\n", t, ms, ms > 0 ? t * 1000 / ms : 0 }'
+    if [ "$THREADS" -lt "$CORES" ] && [ $((THREADS * 2)) -gt "$CORES" ];then THREADS=$CORES; else THREADS=$((THREADS * 2)); fi
+done
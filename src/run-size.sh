@@ -0,0 +1,67 @@
+#!/usr/bin/env sh
+
+PROGRAM=$1
+MAX=${2:-100000}
+
+
+show_usage() {
+    printf "Usage: $0 PROGRAM [MAX-FUNCTIONS]\n\
+    PROGRAM: The executable file.\n\
+    MAX-FUNCTIONS: Largest generated program, in functions, default 100000.\n\
+
+    Example: $0 ./uCML 100000\n\n";
+}
+
+
+if [ "$PROGRAM" = "" ];then
+    echo "Error! Executable not provided.";
+    show_usage;
+    exit 1;
+fi
+
+DATA=$(mktemp -d)
+trap 'rm -rf "$DATA"' EXIT
+
+# Prints the compile time (source to bitcode, nothing is run) and the peak memory of compiling one file.
+measure() {
+    LABEL=$1
+    START=$(date +%s%N)
+    if [ -x /usr/bin/time ];then
+        KB=$(/usr/bin/time -f "%M" "./$PROGRAM" --emit-bc="$DATA/out.bc" "$DATA/source.ml" 2>&1 >/dev/null | tail -n 1)
+    else
+        "./$PROGRAM" --emit-bc="$DATA/out.bc" "$DATA/source.ml" >/dev/null 2>&1
+        KB=0
+    fi
+    MS=$((($(date +%s%N) - START) / 1000000))
+    printf "%-32s%8d ms %8d MiB\n" "$LABEL" "$MS" "$((KB / 1024))"
+}
+
+# Functions calling each other, a global every ten of them.
+N=1000
+while [ "$N" -le "$MAX" ];do
+    awk -v n="$N" 'BEGIN {
+        print "g0:int = 1"
+        print "def f0(x:int):int => {\n    return x + g0\n}"
+        for (i = 1; i < n; i++) {
+            if (i % 10 == 0) printf "g%d:int = %d\n", i, i
+            printf "def f%d(x:int):int => {\n    y:int = x * 3 + g%d\n", i, i - i % 10
+            printf "    if (y > 1000) {\n        return f%d(y %% 1000)\n    }\n    return y\n}\n", i - 1
+        }
+        printf "echo(f%d(7))\n", n - 1
+    }' > "$DATA/source.ml"
+    measure "$N functions"
+    if [ "$N" -lt "$MAX" ] && [ $((N * 10)) -gt "$MAX" ];then N=$MAX; else N=$((N * 10)); fi
+done
+
+# One expression of a million terms, and blocks nested 30000 deep.
+awk 'BEGIN { printf "x:int = 1\ny:int = x"; for (i = 1; i < 1000000; i++) printf " + x"; print "\necho(y)" }' \
+    > "$DATA/source.ml"
+measure "1000000 terms in a row"
+awk 'BEGIN {
+    print "def deep(x:int):int => {"
+    for (i = 0; i < 30000; i++) print "if (x > " i ") {"
+    print "return x"
+    for (i = 0; i < 30000; i++) print "}"
+    print "return 0\n}\necho(deep(5))"
+}' > "$DATA/source.ml"
+measure "30000 nested blocks"
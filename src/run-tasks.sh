@@ -0,0 +1,36 @@
+#!/usr/bin/env sh
+
+PROGRAM=$1
+BENCH_F=$2
+
+
+show_usage() {
+    printf "Usage: $0 PROGRAM BENCH-FILE\n\
+    PROGRAM: The executable file.\n\
+    BENCH-FILE: uCML program spawning tasks, run with 1, 2, 4, ... workers (up to the number of cores).\n\
+
+    Example: $0 ./uCML ../benchmarks/spawn_fib.ml\n\n";
+}
+
+
+if [ "$PROGRAM" = "" ];then
+    echo "Error! Executable not provided.";
+    show_usage;
+    exit 1;
+fi
+if [ "$BENCH_F" = "" ];then
+    echo "Error! Benchmark file not provided.";
+    show_usage;
+    exit 2;
+fi
+
+CORES=$(nproc)
+WORKERS=1
+BASE=0
+while [ "$WORKERS" -le "$CORES" ];do
+    MS=$("./$PROGRAM" -O3 --workers=$WORKERS "$BENCH_F" 2>&1 | grep "Execution completed" | sed 's/[^0-9]//g')
+    if [ "$BASE" -eq 0 ];then BASE=$MS; fi
+    awk -v w="$WORKERS" -v ms="$MS" -v base="$BASE" \
+        'BEGIN { printf "%4d worker(s): %8d ms, %6.2fx speedup\n", w, ms, ms > 0 ? base / ms : 0 }'
+    if [ "$WORKERS" -lt "$CORES" ] && [ $((WORKERS * 2)) -gt "$CORES" ];then WORKERS=$CORES; else WORKERS=$((WORKERS * 2)); fi
+done
@@ -27,7 +27,9 @@ fi
 for f in "$TEST_D/"*.ml;do
 #for f in aaa.ml;do
     echo "Testing file \"$f\":"
-    "./$PROGRAM" "$f" "$f.ir"
+    # Options a test needs are given in its header, on a line "*  options: ...".
+    OPTIONS=$(sed -n 's/^\*  *options: //p' "$f")
+    "./$PROGRAM" $OPTIONS "$f" "$f.ir" < /dev/null
 #    "./$PROGRAM" "$f"
     RET=$?
     echo "Return code: $RET"
@@ -0,0 +1,223 @@
+/*
+   Copyright 2019 Atikur Rahman Chitholian
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <iostream>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <pthread.h>
+#include "tasks.hpp"
+
+namespace {
+    // The header in front of every frame.
+    struct alignas(16) Task {
+        void (*entry)(void *){nullptr};
+        std::atomic<bool> done{false};
+    };
+
+    static_assert(sizeof(Task) == 16, "Frames must stay 16-byte aligned behind their task.");
+
+    Task *taskOf(void *frame) { return reinterpret_cast<Task *>(static_cast<char *>(frame) - sizeof(Task)); }
+
+    void run(Task *task) {
+        task->entry(reinterpret_cast<char *>(task) + sizeof(Task));
+        task->done.store(true, std::memory_order_release);
+    }
+
+    // The owner never pushes onto a deque already holding "cutoff" tasks, so the ring never wraps onto a slot a
+    // thief may still be reading, and it never needs to grow.
+    class Deque {
+        static const int64_t capacity = 2 * ucml::Scheduler::cutoff;
+        std::atomic<int64_t> top{0}, bottom{0};
+        std::atomic<Task *> slots[capacity];
+
+    public:
+        int64_t size() const {
+            return bottom.load(std::memory_order_relaxed) - top.load(std::memory_order_relaxed);
+        }
+
+        void push(Task *task) {
+            int64_t last = bottom.load(std::memory_order_relaxed);
+            slots[last % capacity].store(task, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            bottom.store(last + 1, std::memory_order_relaxed);
+        }
+
+        Task *pop() {
+            int64_t last = bottom.load(std::memory_order_relaxed) - 1;
+            bottom.store(last, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            int64_t first = top.load(std::memory_order_relaxed);
+            Task *task = nullptr;
+            if (first <= last) {
+                task = slots[last % capacity].load(std::memory_order_relaxed);
+                if (first != last) return task;
+                // The last task left, a thief may be taking it too.
+                if (!top.compare_exchange_strong(first, first + 1, std::memory_order_seq_cst,
+                                                 std::memory_order_relaxed))
+                    task = nullptr;
+            }
+            bottom.store(last + 1, std::memory_order_relaxed);
+            return task;
+        }
+
+        Task *steal() {
+            int64_t first = top.load(std::memory_order_acquire);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            int64_t last = bottom.load(std::memory_order_acquire);
+            if (first >= last) return nullptr;
+            Task *task = slots[first % capacity].load(std::memory_order_relaxed);
+            if (!top.compare_exchange_strong(first, first + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+                return nullptr;
+            return task;
+        }
+    };
+
+    struct Thread {
+        Deque deque;
+    };
+
+    // Every thread that ever pushed a task, workers included; threads beyond these run all their tasks inline.
+    const unsigned maxThreads = 256;
+    std::atomic<Thread *> threads[maxThreads];
+    std::atomic<unsigned> registered{0};
+    thread_local Thread *self = nullptr;
+    thread_local bool refused = false;
+    thread_local unsigned seed = 0;
+
+    unsigned workers = 0;
+    std::once_flag started;
+    std::mutex sleepLock;
+    std::condition_variable wakeUp;
+    std::atomic<unsigned> sleeping{0};
+
+    Thread *current() {
+        if (self || refused) return self;
+        unsigned index = registered.fetch_add(1);
+        if (index >= maxThreads) {
+            refused = true;
+            return nullptr;
+        }
+        self = new Thread();
+        threads[index].store(self, std::memory_order_release);
+        seed = index + 1;
+        return self;
+    }
+
+    // Tries every other thread once, starting from a random one.
+    Task *steal() {
+        unsigned count = std::min(registered.load(std::memory_order_acquire), maxThreads);
+        if (!count) return nullptr;
+        seed = seed * 1103515245 + 12345;
+        for (unsigned i = 0, start = (seed >> 16) % count; i < count; ++i) {
+            Thread *victim = threads[(start + i) % count].load(std::memory_order_acquire);
+            if (victim == self || !victim) continue;
+            if (Task *task = victim->deque.steal()) return task;
+        }
+        return nullptr;
+    }
+
+    void work() {
+        current();
+        unsigned idle = 0;
+        while (true) {
+            Task *task = self ? self->deque.pop() : nullptr;
+            if (!task) task = steal();
+            if (task) {
+                run(task);
+                idle = 0;
+            } else if (++idle < 64) {
+                std::this_thread::yield();
+            } else {
+                // Nothing to do for a while: sleep until the next push, or a millisecond at most.
+                std::unique_lock<std::mutex> lock(sleepLock);
+                ++sleeping;
+                wakeUp.wait_for(lock, std::chrono::milliseconds(1));
+                --sleeping;
+            }
+        }
+    }
+
+    void startWorkers() {
+        pthread_attr_t attributes;
+        pthread_attr_init(&attributes);
+        pthread_attr_setstacksize(&attributes, ucml::Scheduler::stackSize);
+        pthread_attr_setdetachstate(&attributes, PTHREAD_CREATE_DETACHED);
+        for (unsigned i = 1; i < ucml::Scheduler::getWorkers(); ++i) {
+            pthread_t worker;
+            // Fewer workers only means less parallelism, the spawning threads still run every task.
+            if (pthread_create(&worker, &attributes, [](void *) -> void * {
+                work();
+                return nullptr;
+            }, nullptr))
+                break;
+        }
+        pthread_attr_destroy(&attributes);
+    }
+}
+
+namespace ucml {
+    void Scheduler::setWorkers(unsigned count) {
+        workers = count;
+    }
+
+    unsigned Scheduler::getWorkers() {
+        return workers ? workers : std::max(std::thread::hardware_concurrency(), 1u);
+    }
+}
+
+void *ucml_task_create(void (*entry)(void *), int64_t frameSize) {
+    void *memory = std::malloc(sizeof(Task) + (size_t) frameSize);
+    if (!memory) {
+        std::cerr << "====> Error! Out of memory for a new task.\n";
+        std::exit(5);
+    }
+    Task *task = new(memory) Task();
+    task->entry = entry;
+    return static_cast<char *>(memory) + sizeof(Task);
+}
+
+void ucml_task_start(void *frame) {
+    Task *task = taskOf(frame);
+    Thread *thread = ucml::Scheduler::getWorkers() > 1 ? current() : nullptr;
+    if (!thread || thread->deque.size() >= ucml::Scheduler::cutoff) {
+        run(task);
+        return;
+    }
+    std::call_once(started, startWorkers);
+    thread->deque.push(task);
+    if (sleeping.load(std::memory_order_relaxed)) wakeUp.notify_one();
+}
+
+void ucml_task_join(void *frame) {
+    Task *task = taskOf(frame);
+    while (!task->done.load(std::memory_order_acquire)) {
+        Task *other = self ? self->deque.pop() : nullptr;
+        if (!other) other = steal();
+        if (other) run(other);
+        else std::this_thread::yield();
+    }
+}
+
+void ucml_task_free(void *frame) {
+    Task *task = taskOf(frame);
+    task->~Task();
+    std::free(task);
+}
@@ -0,0 +1,55 @@
+/*
+   Copyright 2019 Atikur Rahman Chitholian
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+#ifndef UCML_TASKS_H
+#define UCML_TASKS_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace ucml {
+    /**
+     * Runs the tasks of "spawn f(x)" on a pool of worker threads. Every thread spawning tasks owns a deque of them:
+     * it pushes and pops at the bottom while idle workers steal from the top (Chase and Lev, "Dynamic Circular
+     * Work-Stealing Deque"), so thieves take the oldest, usually biggest, pieces of a recursion. A thread waiting in
+     * join() runs other tasks instead of blocking.
+     *
+     * Once "cutoff" tasks are already waiting in its deque, a thread runs the ones it spawns right away, as plain
+     * calls: deep in a recursion there is enough stealable work above, and tiny tasks are not worth handing over.
+     */
+    class Scheduler {
+    public:
+        static const int64_t cutoff = 8;
+
+        // Stack of every thread running uCML code, workers included: deep recursion must not overflow 8 MiB.
+        // Pages are only touched as deep as the program gets.
+        static const size_t stackSize = size_t(1) << 30;
+
+        // Threads running tasks, the spawning one included: one per core unless set before the first spawn.
+        static void setWorkers(unsigned workers);
+
+        static unsigned getWorkers();
+    };
+}
+
+// What "spawn f(x)" and "join(task)" compile to. A task is the frame it is handed: the result of f, then its arguments.
+extern "C" {
+void *ucml_task_create(void (*entry)(void *), int64_t frameSize);
+void ucml_task_start(void *frame);
+void ucml_task_join(void *frame);
+void ucml_task_free(void *frame);
+}
+
+#endif
@@ -0,0 +1,292 @@
+/*
+   Copyright 2019 Atikur Rahman Chitholian
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+#include <iostream>
+#include <set>
+#include <llvm/ADT/STLExtras.h>
+#include <llvm/Analysis/CFG.h>
+#include <llvm/Analysis/TargetTransformInfo.h>
+#include <llvm/Bitcode/BitcodeReader.h>
+#include <llvm/Bitcode/BitcodeWriter.h>
+#include <llvm/ExecutionEngine/SectionMemoryManager.h>
+#include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/InstIterator.h>
+#include <llvm/IR/LegacyPassManager.h>
+#include <llvm/Support/Host.h>
+#include <llvm/Support/TargetRegistry.h>
+#include <llvm/Support/raw_ostream.h>
+#include <llvm/Transforms/Coroutines.h>
+#include <llvm/Transforms/IPO.h>
+#include <llvm/Transforms/IPO/PassManagerBuilder.h>
+#include <llvm/Transforms/Utils/BasicBlockUtils.h>
+#include <llvm/Transforms/Utils/Cloning.h>
+#include "tiered.hpp"
+#include "intrinsics.hpp"
+
+namespace {
+    ucml::TieredJit *active = nullptr;
+
+    const unsigned inlineDepth = 2; // Levels of callees compiled along with a hot function, to be inlined.
+
+    // Links hot code against the running program: its functions (stubs included) and its globals.
+    class ProgramResolver : public llvm::SectionMemoryManager {
+        const std::map<std::string, uint64_t> &symbols;
+    public:
+        explicit ProgramResolver(const std::map<std::string, uint64_t> &symbols) : symbols(symbols) {}
+
+        uint64_t getSymbolAddress(const std::string &name) override {
+            auto symbol = symbols.find(name);
+            return symbol != symbols.end() ? symbol->second : llvm::SectionMemoryManager::getSymbolAddress(name);
+        }
+    };
+
+    long long millisecondsSince(std::chrono::steady_clock::time_point time) {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - time).count();
+    }
+}
+
+void ucml_tier_up(int64_t function) {
+    if (active) active->request((size_t) function);
+}
+
+namespace ucml {
+    TieredJit::TieredJit(const Options &options) : options(options), llvmContext(new llvm::LLVMContext()) {}
+
+    TieredJit::~TieredJit() {
+        stop();
+    }
+
+    void TieredJit::instrument(llvm::Module &module, llvm::Function *mainFunction) {
+        llvm::LLVMContext &context = module.getContext();
+        // Hot code lives in modules of its own, so everything it may refer to must be found by name.
+        for (auto &function : module) {
+            if (function.hasLocalLinkage() && function.hasName())
+                function.setLinkage(llvm::GlobalValue::ExternalLinkage);
+        }
+        for (auto &variable : module.globals()) {
+            if (variable.hasLocalLinkage() && variable.hasName())
+                variable.setLinkage(llvm::GlobalValue::ExternalLinkage);
+        }
+        llvm::raw_string_ostream stream(bitcode);
+        llvm::WriteBitcodeToFile(module, stream);
+        stream.flush();
+
+        std::vector<llvm::Function *> candidates;
+        for (auto &function : module) {
+            // Split parts of generators and task entries (named "f.something") are left as they are.
+            if (function.isDeclaration() || &function == mainFunction || function.isVarArg() ||
+                function.hasFnAttribute("ucml-generator") || function.getName().contains('.'))
+                continue;
+            candidates.push_back(&function);
+        }
+        llvm::Type *int64 = llvm::Type::getInt64Ty(context);
+        llvm::Function *tierUp = module.getFunction("ucml_tier_up");
+        if (!tierUp) {
+            tierUp = llvm::Function::Create(llvm::FunctionType::get(llvm::Type::getVoidTy(context), {int64}, false),
+                                            llvm::GlobalValue::ExternalLinkage, "ucml_tier_up", &module);
+        }
+        for (auto *function : candidates) {
+            std::string name = function->getName().str();
+            function->setName(name + ".tier0");
+            auto *stub = llvm::Function::Create(function->getFunctionType(), llvm::GlobalValue::ExternalLinkage, name,
+                                                &module);
+            stub->copyAttributesFrom(function);
+            function->replaceAllUsesWith(stub); // Recursive calls included, so they pick up the new tier too.
+            auto *target = new llvm::GlobalVariable(module, function->getType(), false,
+                                                    llvm::GlobalValue::ExternalLinkage, function, name + ".target");
+            auto *counter = new llvm::GlobalVariable(module, int64, false, llvm::GlobalValue::ExternalLinkage,
+                                                     llvm::ConstantInt::get(int64, 0), name + ".count");
+
+            llvm::IRBuilder<> builder(llvm::BasicBlock::Create(context, "entry", stub));
+            llvm::LoadInst *tier = builder.CreateLoad(target, "tier");
+            tier->setAtomic(llvm::AtomicOrdering::Acquire);
+            tier->setAlignment(8);
+            std::vector<llvm::Value *> arguments;
+            for (auto &argument : stub->args()) arguments.push_back(&argument);
+            llvm::CallInst *call = builder.CreateCall(tier, arguments);
+            call->setTailCall();
+            if (stub->getReturnType()->isVoidTy()) builder.CreateRetVoid();
+            else builder.CreateRet(call);
+
+            // Count on entry, after the allocas, and on every back-edge.
+            llvm::BasicBlock &entry = function->getEntryBlock();
+            auto first = entry.begin();
+            while (llvm::isa<llvm::AllocaInst>(*first)) ++first;
+            std::set<llvm::Instruction *> points{&*first};
+            llvm::SmallVector<std::pair<const llvm::BasicBlock *, const llvm::BasicBlock *>, 8> backEdges;
+            llvm::FindFunctionBackedges(*function, backEdges);
+            for (auto &edge : backEdges) points.insert(const_cast<llvm::BasicBlock *>(edge.first)->getTerminator());
+            for (auto *point : points) {
+                builder.SetInsertPoint(point);
+                llvm::Value *count = builder.CreateAtomicRMW(llvm::AtomicRMWInst::Add, counter,
+                                                             builder.getInt64(1), llvm::AtomicOrdering::Monotonic);
+                llvm::Value *hot = builder.CreateICmpEQ(count, builder.getInt64(options.tierUpAfter - 1), "hot");
+                builder.SetInsertPoint(llvm::SplitBlockAndInsertIfThen(hot, point, false));
+                builder.CreateCall(tierUp, {builder.getInt64(functions.size())});
+            }
+            functions.push_back(Tier());
+            functions.back().name = name;
+        }
+    }
+
+    void TieredJit::start(llvm::ExecutionEngine &engine, llvm::Module &module) {
+        engine.addGlobalMapping("ucml_tier_up", (uint64_t) (uintptr_t) &ucml_tier_up);
+        engine.finalizeObject();
+        for (auto &function : module) {
+            if (!function.isDeclaration() && function.hasName() && !function.getName().startswith("llvm."))
+                symbols[function.getName().str()] = engine.getFunctionAddress(function.getName().str());
+        }
+        for (auto &variable : module.globals()) {
+            if (!variable.isDeclaration() && variable.hasName() && !variable.getName().startswith("llvm."))
+                symbols[variable.getName().str()] = engine.getGlobalValueAddress(variable.getName().str());
+        }
+        for (auto &function : functions) function.target = symbols[function.name + ".target"];
+        active = this;
+        compiler = std::thread(&TieredJit::compileLoop, this);
+    }
+
+    void TieredJit::request(size_t function) {
+        std::lock_guard<std::mutex> guard(lock);
+        functions[function].hot = std::chrono::steady_clock::now();
+        queue.push_back(function);
+        wakeUp.notify_one();
+    }
+
+    void TieredJit::stop() {
+        if (!compiler.joinable()) return;
+        size_t left;
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            stopping = true;
+            left = queue.size();
+            wakeUp.notify_one();
+        }
+        compiler.join();
+        active = nullptr;
+        E("====> Tiered run: " << compiled << " of " << functions.size() << " function(s) recompiled at -O"
+                              << options.tierLevel << (left ? ", " + std::to_string(left) + " still queued" : "")
+                              << ".");
+    }
+
+    void TieredJit::compileLoop() {
+        while (true) {
+            size_t function;
+            {
+                std::unique_lock<std::mutex> guard(lock);
+                wakeUp.wait(guard, [this] { return stopping || !queue.empty(); });
+                if (stopping) return;
+                function = queue.front();
+                queue.pop_front();
+            }
+            compile(function);
+        }
+    }
+
+    void TieredJit::compile(size_t function) {
+        auto startTime = std::chrono::steady_clock::now();
+        const std::string &name = functions[function].name;
+        if (!snapshot) {
+            auto parsed = llvm::parseBitcodeFile(llvm::MemoryBufferRef(bitcode, "tiered"), *llvmContext);
+            if (!parsed) {
+                E("====> Error! Cannot recompile \"" << name << "\", " << llvm::toString(parsed.takeError()));
+                return;
+            }
+            snapshot = std::move(*parsed);
+            std::string().swap(bitcode);
+        }
+        const llvm::Function *original = snapshot->getFunction(name);
+        uint64_t *stubTarget = reinterpret_cast<uint64_t *>(functions[function].target);
+        if (!original || !stubTarget) {
+            E("====> Error! Cannot recompile \"" << name << "\", it is not in the program.");
+            return;
+        }
+        // Only the hot function is compiled, its callees come along to be inlined and everything else is declared,
+        // so a tier-up costs as much as the function does, not the whole program. Calls left over go to the program.
+        std::set<const llvm::GlobalValue *> bodies{original};
+        std::vector<const llvm::Function *> callers{original};
+        for (unsigned depth = 0; depth < inlineDepth && !callers.empty(); ++depth) {
+            std::vector<const llvm::Function *> callees;
+            for (auto *caller : callers) {
+                for (auto &instruction : llvm::instructions(caller)) {
+                    auto *call = llvm::dyn_cast<llvm::CallInst>(&instruction);
+                    const llvm::Function *callee = call ? call->getCalledFunction() : nullptr;
+                    if (callee && !callee->isDeclaration() && bodies.insert(callee).second) callees.push_back(callee);
+                }
+            }
+            callers.swap(callees);
+        }
+        llvm::ValueToValueMapTy clones;
+        std::unique_ptr<llvm::Module> module = llvm::CloneModule(*snapshot, clones, [&bodies](
+                const llvm::GlobalValue *value) { return bodies.count(value) != 0; });
+        llvm::Function *hot = module->getFunction(name);
+        for (auto &other : *module) {
+            if (&other != hot && !other.isDeclaration())
+                other.setLinkage(llvm::GlobalValue::AvailableExternallyLinkage);
+        }
+        hot->setName(name + ".tier1");
+
+        std::string error, triple = llvm::sys::getDefaultTargetTriple();
+        const llvm::Target *target = llvm::TargetRegistry::lookupTarget(triple, error);
+        llvm::TargetMachine *targetMachine = target ? target->createTargetMachine(
+                triple, options.cpu, options.features, llvm::TargetOptions(), llvm::Reloc::PIC_, llvm::None,
+                llvm::CodeGenOpt::Aggressive) : nullptr;
+        if (!targetMachine) {
+            E("====> Error! Cannot recompile \"" << name << "\", no target machine for \"" << options.cpu << "\".");
+            return;
+        }
+        llvm::PassManagerBuilder passManagerBuilder;
+        passManagerBuilder.OptLevel = std::min(options.tierLevel, 3u);
+        passManagerBuilder.SizeLevel = 0;
+        passManagerBuilder.Inliner = llvm::createFunctionInliningPass(passManagerBuilder.OptLevel, 0, false);
+        passManagerBuilder.LoopVectorize = options.tierLevel > 1;
+        passManagerBuilder.SLPVectorize = options.tierLevel > 1;
+        llvm::addCoroutinePassesToExtensionPoints(passManagerBuilder);
+        targetMachine->adjustPassManager(passManagerBuilder);
+        llvm::legacy::FunctionPassManager functionPasses(module.get());
+        llvm::legacy::PassManager modulePasses;
+        functionPasses.add(llvm::createTargetTransformInfoWrapperPass(targetMachine->getTargetIRAnalysis()));
+        modulePasses.add(llvm::createTargetTransformInfoWrapperPass(targetMachine->getTargetIRAnalysis()));
+        passManagerBuilder.populateFunctionPassManager(functionPasses);
+        passManagerBuilder.populateModulePassManager(modulePasses);
+        functionPasses.doInitialization();
+        functionPasses.run(*hot);
+        functionPasses.doFinalization();
+        modulePasses.run(*module);
+
+        llvm::ExecutionEngine *engine = llvm::EngineBuilder(std::move(module))
+                .setErrorStr(&error)
+                .setMCJITMemoryManager(llvm::make_unique<ProgramResolver>(symbols))
+                .setOptLevel(llvm::CodeGenOpt::Aggressive)
+                .create(targetMachine);
+        if (!engine) {
+            E("====> Error! Cannot recompile \"" << name << "\", " << error);
+            return;
+        }
+        engines.emplace_back(engine);
+        Intrinsics::bind(*engine);
+        engine->finalizeObject();
+        uint64_t address = engine->getFunctionAddress(name + ".tier1");
+        if (!address) {
+            E("====> Error! Cannot find recompiled \"" << name << "\".");
+            return;
+        }
+        // From now on the stub calls the new code; calls already running finish in the old tier.
+        __atomic_store_n(stubTarget, address, __ATOMIC_RELEASE);
+        ++compiled;
+        E("====> Tier-up: \"" << name << "\" hot after " << options.tierUpAfter << " calls/iterations, compiled at -O"
+                             << options.tierLevel << " in " << millisecondsSince(startTime) << " ms ("
+                             << millisecondsSince(functions[function].hot) << " ms after getting hot).");
+    }
+}
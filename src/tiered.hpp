@@ -0,0 +1,91 @@
+/*
+   Copyright 2019 Atikur Rahman Chitholian
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+#ifndef UCML_TIERED_H
+#define UCML_TIERED_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <llvm/IR/LLVMContext.h>
+#include <llvm/IR/Module.h>
+#include <llvm/ExecutionEngine/ExecutionEngine.h>
+#include "tools.hpp"
+
+namespace ucml {
+    /**
+     * Tiered execution (--tiered): the program starts right away at -O0 and functions that turn out to be hot are
+     * recompiled at -O3 (or the -O level given) on a background thread.
+     *
+     * Every function "f" becomes a stub calling through the pointer "f.target", which first holds "f.tier0", the
+     * -O0 body counting its calls and loop back-edges in "f.count". When the count reaches the threshold, the
+     * function is queued; the compile thread optimizes it from a copy of the module taken before instrumenting, along
+     * with the bodies of its callees for inlining, JITs it against the symbols of the running program and stores its
+     * address in "f.target". Calls already running stay in the old tier, only later calls get the new code.
+     */
+    class TieredJit {
+        struct Tier {
+            std::string name;
+            uint64_t target{0}; // Address of "name.target".
+            std::chrono::steady_clock::time_point hot;
+        };
+
+        Options options;
+        std::string bitcode; // The module before instrumenting, what hot functions are compiled from.
+        std::vector<Tier> functions;
+        std::map<std::string, uint64_t> symbols;
+        std::unique_ptr<llvm::LLVMContext> llvmContext;
+        std::unique_ptr<llvm::Module> snapshot; // The bitcode, parsed by the compile thread on the first tier-up.
+        std::vector<std::unique_ptr<llvm::ExecutionEngine>> engines;
+        std::thread compiler;
+        std::mutex lock;
+        std::condition_variable wakeUp;
+        std::deque<size_t> queue;
+        bool stopping{false};
+        unsigned compiled{0};
+
+        void compileLoop();
+
+        void compile(size_t function);
+
+    public:
+        explicit TieredJit(const Options &options);
+
+        ~TieredJit();
+
+        // Makes every function a stub plus an instrumented -O0 body; call before the module is JIT'd.
+        void instrument(llvm::Module &module, llvm::Function *mainFunction);
+
+        // Compiles the baseline and starts the compile thread.
+        void start(llvm::ExecutionEngine &engine, llvm::Module &module);
+
+        // Called by instrumented code, once per function.
+        void request(size_t function);
+
+        // Waits for the compilation in progress and prints a summary.
+        void stop();
+    };
+}
+
+extern "C" void ucml_tier_up(int64_t function);
+
+#endif
@@ -15,7 +15,19 @@
 */
 #include <vector>
 #include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <pthread.h>
 #include <llvm/Support/TargetSelect.h>
+#include <llvm/Support/TargetRegistry.h>
+#include <llvm/Support/Host.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/Path.h>
+#include <llvm/IR/DebugInfoMetadata.h>
+#include <llvm/IR/DiagnosticInfo.h>
+#include <llvm/IR/DiagnosticHandler.h>
+#include <llvm/ExecutionEngine/JITEventListener.h>
+#include <llvm/ADT/StringMap.h>
 #include <llvm/IR/Type.h>
 #include <llvm/IR/DerivedTypes.h>
 #include <llvm/IR/Function.h>
@@ -23,19 +35,153 @@
 #include <llvm/IR/GlobalVariable.h>
 #include <llvm/IR/Instructions.h>
 #include <llvm/IR/IRPrintingPasses.h>
+#include <llvm/IR/LegacyPassManager.h>
+#include <llvm/IRReader/IRReader.h>
+#include <llvm/Bitcode/BitcodeWriter.h>
+#include <llvm/Linker/Linker.h>
+#include <llvm/Support/SourceMgr.h>
+#include <llvm/Transforms/IPO/Internalize.h>
+#include <llvm/Analysis/TargetTransformInfo.h>
+#include <llvm/Transforms/IPO.h>
+#include <llvm/Transforms/IPO/PassManagerBuilder.h>
+#include <llvm/Transforms/Coroutines.h>
 #include <llvm/ExecutionEngine/GenericValue.h>
 #include <llvm/ExecutionEngine/ExecutionEngine.h>
 #include "tools.hpp"
+#include "library.hpp"
+#include "perfmap.hpp"
+#include "intrinsics.hpp"
+#include "tiered.hpp"
+#include "tasks.hpp"
+#include "parser.hpp"
+
+extern int yylineno;
+
+extern void yyrestart(FILE *input);
 
 namespace ucml {
 
-    Tools::Tools(Context &context, Block *codeBlock) : context(context), codeBlock(codeBlock) {}
+    Tools::Tools(Context &context, Block *codeBlock, const Options &options) : context(context), codeBlock(codeBlock),
+                                                                               options(options),
+                                                                               targetMachine(nullptr),
+                                                                               executionEngine(nullptr),
+                                                                               objectCache(nullptr) {}
+
+    bool Tools::recoverErrors = false;
+
+    // LLVM reports loop hints (unroll, vectorize, interleave) it could not honour as optimization failures;
+    // print those like our own warnings, everything else keeps LLVM's default handling.
+    class LoopHintReporter : public llvm::DiagnosticHandler {
+    public:
+        bool handleDiagnostics(const llvm::DiagnosticInfo &info) override {
+            if (info.getKind() != llvm::DK_OptimizationFailure) return false;
+            auto &failure = llvm::cast<llvm::DiagnosticInfoOptimizationFailure>(info);
+            std::string message = "In function \"" + failure.getFunction().getName().str() + "\", " + failure.getMsg();
+            if (!failure.isLocationAvailable()) { // Only known with -g.
+                std::cerr << "W:" << message << "\n";
+                return true;
+            }
+            YYLTYPE location{};
+            location.first_line = (int) failure.getLocation().getLine();
+            location.first_column = (int) failure.getLocation().getColumn();
+            W(location, message);
+            return true;
+        }
+    };
+
+    void Tools::abortCompilation() {
+        if (recoverErrors) throw CompileError();
+        exit(1);
+    }
 
-    Tools Tools::initialize(Block *codeBlock, Context &context) {
+    Tools Tools::initialize(Block *codeBlock, Context &context, const Options &options) {
         llvm::InitializeNativeTarget();
         llvm::InitializeNativeTargetAsmPrinter();
         llvm::InitializeNativeTargetAsmParser();
-        return Tools(context, codeBlock);
+
+        Tools tools(context, codeBlock, options);
+        Options &resolved = tools.options;
+        if (resolved.cpu == "native") {
+            // Detect the host so the code generator may use every available extension (AVX2, AVX-512, FMA, ...).
+            resolved.cpu = llvm::sys::getHostCPUName().str();
+            llvm::StringMap<bool> hostFeatures;
+            std::string features;
+            if (llvm::sys::getHostCPUFeatures(hostFeatures)) {
+                for (auto &feature : hostFeatures) {
+                    features += (features.empty() ? "" : ",");
+                    features += (feature.getValue() ? "+" : "-") + feature.getKey().str();
+                }
+            }
+            if (!resolved.features.empty()) // Explicit -mattr wins over detected features.
+                features += (features.empty() ? "" : ",") + resolved.features;
+            resolved.features = features;
+        } else if (resolved.cpu.empty()) {
+            resolved.cpu = "generic";
+        }
+
+        std::string error, triple = llvm::sys::getDefaultTargetTriple();
+        const llvm::Target *target = llvm::TargetRegistry::lookupTarget(triple, error);
+        if (!target) {
+            E("====> Error! Cannot find target \"" << triple << "\", " << error);
+            exit(1);
+        }
+        auto codeGenLevel = static_cast<llvm::CodeGenOpt::Level>(std::min(resolved.optLevel, 3u));
+        llvm::TargetOptions targetOptions;
+        if (resolved.threads) {
+            // The JIT cannot resolve native TLS relocations; emulated TLS reaches thread-local globals through
+            // __emutls_get_address() of the host instead.
+            targetOptions.EmulatedTLS = true;
+            targetOptions.ExplicitEmulatedTLS = true;
+        }
+        tools.targetMachine = target->createTargetMachine(triple, resolved.cpu, resolved.features, targetOptions,
+                                                          llvm::Reloc::PIC_, llvm::None, codeGenLevel);
+        if (!tools.targetMachine) {
+            E("====> Error! Cannot create target machine for CPU \"" << resolved.cpu << "\".");
+            exit(1);
+        }
+        tools.prepareModule();
+        context.llvmContext.setDiagnosticHandler(std::unique_ptr<llvm::DiagnosticHandler>(new LoopHintReporter()));
+        context.importPaths.insert(context.importPaths.end(), resolved.importPaths.begin(),
+                                   resolved.importPaths.end());
+        llvm::LLVMContext &llvmContext = context.llvmContext;
+        context.buildLibrary = [resolved, &llvmContext](const std::string &source) {
+            return Library::build(source, resolved, llvmContext);
+        };
+        return tools;
+    }
+
+    void Tools::prepareModule() {
+        context.module->setTargetTriple(targetMachine->getTargetTriple().str());
+        context.module->setDataLayout(targetMachine->createDataLayout());
+        // Code compiled for one CPU must never be mixed with (or mistaken for) code compiled for another.
+        context.module->addModuleFlag(llvm::Module::Error, "ucml.target",
+                                      llvm::MDString::get(context.llvmContext, targetIdentity()));
+        if (!options.debugInfo) return;
+        context.module->addModuleFlag(llvm::Module::Warning, "Debug Info Version", llvm::DEBUG_METADATA_VERSION);
+        context.module->addModuleFlag(llvm::Module::Warning, "Dwarf Version", 4);
+        context.debugBuilder = new llvm::DIBuilder(*context.module);
+        std::string sourceFile = options.sourceFile.empty() ? "<stdin>" : options.sourceFile;
+        context.debugFile = context.debugBuilder->createFile(llvm::sys::path::filename(sourceFile),
+                                                             llvm::sys::path::parent_path(sourceFile));
+        context.debugUnit = context.debugBuilder->createCompileUnit(llvm::dwarf::DW_LANG_C, context.debugFile,
+                                                                    "uCML", options.optLevel > 0, "", 0);
+    }
+
+    const Options &Tools::getOptions() const {
+        return options;
+    }
+
+    void Tools::setObjectCache(llvm::ObjectCache *cache) {
+        objectCache = cache;
+        if (executionEngine) executionEngine->setObjectCache(cache);
+    }
+
+    void Tools::setCodeBlock(Block *block) {
+        codeBlock = block;
+    }
+
+    std::string Tools::targetIdentity() const {
+        return llvm::sys::getDefaultTargetTriple() + ";" + options.cpu + ";" + options.features;
     }
 
     void Tools::createBuiltInFunctions() {
@@ -54,7 +200,7 @@ namespace ucml {
         arg_types = std::vector<llvm::Type *>();
         arg_types.push_back(llvm::Type::getInt64Ty(context.llvmContext));
         functionType = llvm::FunctionType::get(llvm::Type::getVoidTy(context.llvmContext), arg_types, false);
-        llvm::Function *echoInteger = llvm::Function::Create(functionType, llvm::Function::InternalLinkage,
+        llvm::Function *echoInteger = llvm::Function::Create(functionType, context.definitionLinkage(),
                                                              llvm::Twine("echoint"), context.module);
 
         llvm::BasicBlock *block = llvm::BasicBlock::Create(context.llvmContext, "entry", echoInteger);
@@ -70,7 +216,7 @@ namespace ucml {
         arg_types = std::vector<llvm::Type *>();
         arg_types.push_back(llvm::Type::getDoubleTy(context.llvmContext));
         functionType = llvm::FunctionType::get(llvm::Type::getVoidTy(context.llvmContext), arg_types, false);
-        llvm::Function *echoDouble = llvm::Function::Create(functionType, llvm::Function::InternalLinkage,
+        llvm::Function *echoDouble = llvm::Function::Create(functionType, context.definitionLinkage(),
                                                             llvm::Twine("echodouble"), context.module);
 
         llvm::BasicBlock *block2 = llvm::BasicBlock::Create(context.llvmContext, "entry", echoDouble);
@@ -84,12 +230,72 @@ namespace ucml {
         std::cout << "====> Built-in functions are created.\n";
     }
 
-    llvm::Function *Tools::generateCode() {
+    void Tools::createBatchFunctions() {
+        std::vector<llvm::Function *> scalarFunctions;
+        for (auto &function : *context.module) {
+            if (function.isDeclaration() || function.hasLocalLinkage() || function.arg_empty() ||
+                !isValidType(nameOf(function.getReturnType())))
+                continue;
+            bool isScalar = true;
+            for (auto &argument : function.args()) isScalar = isScalar && isValidType(nameOf(argument.getType()));
+            if (isScalar) scalarFunctions.push_back(&function);
+        }
+
+        // For every f(a:A, b:B):R, a host-callable loop over columns, in C terms:
+        //     void f_batch(const A *a, const B *b, R *out, size_t n) { for i < n: out[i] = f(a[i], b[i]) }
+        // which the optimizer inlines f into and vectorizes.
+        llvm::Type *sizeType = llvm::Type::getInt64Ty(context.llvmContext);
+        for (auto *function : scalarFunctions) {
+            std::vector<llvm::Type *> columnTypes;
+            for (auto &argument : function->args()) columnTypes.push_back(argument.getType()->getPointerTo());
+            columnTypes.push_back(function->getReturnType()->getPointerTo());
+            columnTypes.push_back(sizeType);
+            auto *batch = llvm::Function::Create(
+                    llvm::FunctionType::get(llvm::Type::getVoidTy(context.llvmContext), columnTypes, false),
+                    llvm::GlobalValue::ExternalLinkage, function->getName() + "_batch", context.module);
+            // Columns never overlap, so the vectorizer needs no runtime alias checks.
+            for (unsigned i = 0; i + 1 < batch->arg_size(); ++i) batch->addParamAttr(i, llvm::Attribute::NoAlias);
+
+            llvm::BasicBlock *entry = llvm::BasicBlock::Create(context.llvmContext, "entry", batch),
+                    *loop = llvm::BasicBlock::Create(context.llvmContext, "row", batch),
+                    *done = llvm::BasicBlock::Create(context.llvmContext, "done", batch);
+            llvm::IRBuilder<> builder(entry);
+            llvm::Value *rows = &*std::prev(batch->arg_end());
+            builder.CreateCondBr(builder.CreateICmpEQ(rows, llvm::ConstantInt::get(sizeType, 0)), done, loop);
+            builder.SetInsertPoint(loop);
+            llvm::PHINode *row = builder.CreatePHI(sizeType, 2, "i");
+            row->addIncoming(llvm::ConstantInt::get(sizeType, 0), entry);
+            std::vector<llvm::Value *> arguments;
+            auto column = batch->arg_begin();
+            for (auto &argument : function->args()) {
+                arguments.push_back(builder.CreateLoad(builder.CreateInBoundsGEP(argument.getType(), &*column, row)));
+                ++column;
+            }
+            llvm::Value *result = builder.CreateCall(function, llvm::makeArrayRef(arguments));
+            builder.CreateStore(result, builder.CreateInBoundsGEP(function->getReturnType(), &*column, row));
+            llvm::Value *next = builder.CreateAdd(row, llvm::ConstantInt::get(sizeType, 1), "next", true, true);
+            row->addIncoming(next, loop);
+            builder.CreateCondBr(builder.CreateICmpULT(next, rows), loop, done);
+            builder.SetInsertPoint(done);
+            builder.CreateRetVoid();
+        }
+    }
+
+    bool Tools::isBatchFunction(const llvm::Function &function) {
+        return function.getName().endswith("_batch") && !function.arg_empty() &&
+               function.arg_begin()->getType()->isPointerTy();
+    }
+
+    llvm::Function *Tools::generateCode(const std::string &entryName) {
         std::vector<llvm::Type *> argTypes;
         llvm::FunctionType *functionType = llvm::FunctionType::get(llvm::Type::getInt64Ty(context.llvmContext),
                                                                    makeArrayRef(argTypes), false);
-        llvm::Function *mainFunction = llvm::Function::Create(functionType, llvm::GlobalValue::InternalLinkage, "main",
+        llvm::Function *mainFunction = llvm::Function::Create(functionType, context.definitionLinkage(), entryName,
                                                               context.module);
+        context.mainFunction = mainFunction;
+        YYLTYPE start;
+        start.first_line = start.first_column = 1;
+        createDebugFunction(context, mainFunction, start);
         llvm::BasicBlock *block = llvm::BasicBlock::Create(context.llvmContext, "entry", mainFunction, nullptr);
 
         context.createNewScope(block);
@@ -102,56 +308,473 @@ namespace ucml {
         return mainFunction;
     }
 
+    void Tools::optimize(llvm::Function *mainFunction) {
+        if (context.debugBuilder) context.debugBuilder->finalize();
+        if (!Intrinsics::link(*context.module)) abortCompilation();
+        if (options.threads) {
+            // Every thread running the program gets its own copy of its state (libraries' included).
+            for (auto &global : context.module->globals()) {
+                if (!global.isDeclaration() && !global.isConstant()) global.setThreadLocal(true);
+            }
+        }
+        bool hasWideVectors = options.features.find("+avx512f") != std::string::npos;
+        for (auto &function : *context.module) {
+            if (function.isDeclaration()) continue;
+            function.addFnAttr("target-cpu", options.cpu);
+            function.addFnAttr("target-features", options.features);
+            // By default LLVM prefers 256-bit vectors even on AVX-512 parts; ask for the full register width.
+            if (hasWideVectors) function.addFnAttr("prefer-vector-width", "512");
+            // Frame pointers let "perf record --call-graph fp" walk through JIT'd frames.
+            if (options.debugInfo) function.addFnAttr("no-frame-pointer-elim", "true");
+        }
+        // Generators are coroutines, which have to be split into their resume functions even at -O0.
+        bool hasCoroutines = false;
+        for (auto &function : *context.module) {
+            hasCoroutines = hasCoroutines || function.getName().startswith("llvm.coro.");
+        }
+        if (!options.optLevel && context.loopHints) {
+            E("====> Warning! " << context.loopHints << " loop(s) with unroll/vectorize/interleave hints left as "
+                                                     "they are, hints need -O1 or higher.");
+        }
+        context.loopHints = 0;
+        if (!options.optLevel && !hasCoroutines) return;
+
+        llvm::PassManagerBuilder passManagerBuilder;
+        passManagerBuilder.OptLevel = std::min(options.optLevel, 3u);
+        passManagerBuilder.SizeLevel = 0;
+        if (options.optLevel) {
+            std::cout << "====> Optimizing IR at level -O" << options.optLevel << " for CPU \"" << options.cpu
+                      << "\"...\n";
+            // Internal functions without users get dropped by GlobalDCE, keep the entry point alive.
+            mainFunction->setLinkage(llvm::GlobalValue::ExternalLinkage);
+            passManagerBuilder.Inliner = llvm::createFunctionInliningPass(passManagerBuilder.OptLevel, 0, false);
+        }
+        passManagerBuilder.LoopVectorize = options.optLevel > 1;
+        passManagerBuilder.SLPVectorize = options.optLevel > 1;
+        llvm::addCoroutinePassesToExtensionPoints(passManagerBuilder);
+        targetMachine->adjustPassManager(passManagerBuilder);
+
+        llvm::legacy::FunctionPassManager functionPasses(context.module);
+        llvm::legacy::PassManager modulePasses;
+        functionPasses.add(llvm::createTargetTransformInfoWrapperPass(targetMachine->getTargetIRAnalysis()));
+        modulePasses.add(llvm::createTargetTransformInfoWrapperPass(targetMachine->getTargetIRAnalysis()));
+        passManagerBuilder.populateFunctionPassManager(functionPasses);
+        passManagerBuilder.populateModulePassManager(modulePasses);
+
+        functionPasses.doInitialization();
+        for (auto &function : *context.module) functionPasses.run(function);
+        functionPasses.doFinalization();
+        modulePasses.run(*context.module);
+    }
+
     void Tools::printIR(llvm::raw_ostream &oStream) {
         context.module->print(oStream, nullptr);
     }
 
+    bool Tools::emitObject(llvm::Function *mainFunction, const std::string &fileName) {
+        std::cout << "====> Emitting object file for CPU \"" << options.cpu << "\"...\n";
+        std::error_code errorCode;
+        llvm::raw_fd_ostream fileStream(fileName, errorCode, llvm::sys::fs::OpenFlags::F_None);
+        if (errorCode.value()) {
+            E("====> Error! Cannot write to file \"" << fileName << "\", " << errorCode.message());
+            return false;
+        }
+        // The object file is linked by a system linker, so "main" must be visible to it.
+        mainFunction->setLinkage(llvm::GlobalValue::ExternalLinkage);
+        llvm::legacy::PassManager passManager;
+        if (targetMachine->addPassesToEmitFile(passManager, fileStream, nullptr,
+                                               llvm::TargetMachine::CGFT_ObjectFile)) {
+            E("====> Error! Target \"" << llvm::sys::getDefaultTargetTriple() << "\" cannot emit object files.");
+            return false;
+        }
+        passManager.run(*context.module);
+        fileStream.flush();
+        std::cout << "====> Object file written to \"" << fileName << "\".\n";
+        return true;
+    }
+
+    bool Tools::emitBitcode(const std::string &fileName) {
+        std::error_code errorCode;
+        llvm::raw_fd_ostream fileStream(fileName, errorCode, llvm::sys::fs::OpenFlags::F_None);
+        if (errorCode.value()) {
+            E("====> Error! Cannot write to file \"" << fileName << "\", " << errorCode.message());
+            return false;
+        }
+        llvm::WriteBitcodeToFile(*context.module, fileStream);
+        fileStream.flush();
+        std::cout << "====> Bitcode written to \"" << fileName << "\", run it with \"uCML " << fileName << "\".\n";
+        return true;
+    }
+
+    llvm::Function *Tools::loadProgram(const std::string &fileName) {
+        llvm::SMDiagnostic error;
+        std::unique_ptr<llvm::Module> module = llvm::parseIRFile(fileName, error, context.llvmContext);
+        if (!module) {
+            E("====> Error! Cannot load \"" << fileName << "\", " << error.getMessage().str());
+            return nullptr;
+        }
+        auto *flag = llvm::dyn_cast_or_null<llvm::MDString>(module->getModuleFlag("ucml.target"));
+        if (!flag || flag->getString() != targetIdentity()) {
+            E("====> Error! \"" << fileName << "\" was compiled for another target, compile it again");
+            return nullptr;
+        }
+        llvm::Function *mainFunction = module->getFunction("main");
+        if (!mainFunction || mainFunction->isDeclaration()) {
+            E("====> Error! \"" << fileName << "\" is not a compiled program");
+            return nullptr;
+        }
+        delete context.module;
+        context.module = module.release();
+        context.mainFunction = mainFunction;
+        return mainFunction;
+    }
+
     llvm::GenericValue Tools::runCode(llvm::Function *mainFunction) {
         std::cout << "====> Running Code...\n";
-        llvm::ExecutionEngine *executionEngine = llvm::EngineBuilder(
-                std::unique_ptr<llvm::Module>(context.module)).create();
+        createExecutionEngine(context.module);
         executionEngine->finalizeObject();
         std::vector<llvm::GenericValue> args;
+        auto startTime = std::chrono::steady_clock::now();
         llvm::GenericValue genericValue = executionEngine->runFunction(mainFunction, args);
-        std::cout << "====> Execution completed.\n";
+        auto endTime = std::chrono::steady_clock::now();
+        fflush(stdout);
+        std::cout << "====> Execution completed in "
+                  << std::chrono::duration_cast<std::chrono::milliseconds>(endTime - startTime).count() << " ms.\n";
         return genericValue;
     }
 
+    void Tools::runConcurrently(llvm::Function *mainFunction, unsigned threads) {
+        std::cout << "====> Running Code on " << threads << " thread(s)...\n";
+        mainFunction->setLinkage(llvm::GlobalValue::ExternalLinkage); // The JIT only looks up external symbols.
+        createExecutionEngine(context.module);
+        executionEngine->finalizeObject();
+        auto program = (int64_t (*)()) executionEngine->getFunctionAddress(mainFunction->getName().str());
+        if (!program) {
+            E("====> Error! Cannot find the compiled program.");
+            return;
+        }
+        // Every run gets the same deep stack as a single run has.
+        pthread_attr_t attributes;
+        pthread_attr_init(&attributes);
+        pthread_attr_setstacksize(&attributes, Scheduler::stackSize);
+        std::vector<pthread_t> runners;
+        auto startTime = std::chrono::steady_clock::now();
+        for (unsigned i = 0; i < threads; ++i) {
+            pthread_t runner;
+            if (pthread_create(&runner, &attributes, [](void *entry) -> void * {
+                (*static_cast<int64_t (**)()>(entry))();
+                return nullptr;
+            }, &program)) {
+                E("====> Error! Cannot start thread " << i + 1 << " of " << threads << ".");
+                break;
+            }
+            runners.push_back(runner);
+        }
+        pthread_attr_destroy(&attributes);
+        for (auto &runner : runners) pthread_join(runner, nullptr);
+        auto endTime = std::chrono::steady_clock::now();
+        fflush(stdout);
+        std::cout << "====> " << threads << " concurrent run(s) completed in "
+                  << std::chrono::duration_cast<std::chrono::milliseconds>(endTime - startTime).count() << " ms.\n";
+    }
+
+    void Tools::runTiered(llvm::Function *mainFunction) {
+        std::cout << "====> Running Code at -O0, hot functions recompiled at -O" << options.tierLevel << "...\n";
+        auto startTime = std::chrono::steady_clock::now();
+        TieredJit tiers(options);
+        tiers.instrument(*context.module, mainFunction);
+        createExecutionEngine(context.module);
+        tiers.start(*executionEngine, *context.module);
+        auto runTime = std::chrono::steady_clock::now();
+        std::cout << "====> Baseline compiled in "
+                  << std::chrono::duration_cast<std::chrono::milliseconds>(runTime - startTime).count() << " ms.\n";
+        std::vector<llvm::GenericValue> args;
+        executionEngine->runFunction(mainFunction, args);
+        auto endTime = std::chrono::steady_clock::now();
+        fflush(stdout);
+        std::cout << "====> Execution completed in "
+                  << std::chrono::duration_cast<std::chrono::milliseconds>(endTime - runTime).count() << " ms.\n";
+        tiers.stop();
+    }
+
+    void Tools::createExecutionEngine(llvm::Module *module) {
+        // Reuse our configured target machine so JIT'd code is tuned exactly like AOT code.
+        executionEngine = llvm::EngineBuilder(std::unique_ptr<llvm::Module>(module))
+                .setOptLevel(targetMachine->getOptLevel()).create(targetMachine);
+        if (objectCache) executionEngine->setObjectCache(objectCache);
+        Intrinsics::bind(*executionEngine);
+        if (options.debugInfo) {
+            // Make JIT'd functions and their line tables visible to gdb and perf.
+            executionEngine->RegisterJITEventListener(llvm::JITEventListener::createGDBRegistrationListener());
+            llvm::JITEventListener *perfListener = llvm::JITEventListener::createPerfJITEventListener();
+            executionEngine->RegisterJITEventListener(perfListener ? perfListener : new PerfMapListener());
+        }
+    }
+
+    std::vector<std::string> Tools::linkLibraries() {
+        std::vector<std::string> identifiers;
+        llvm::StringSet<> librarySymbols;
+        for (; context.linkedLibraries < context.libraries.size(); ++context.linkedLibraries) {
+            const std::string &fileName = context.libraries[context.linkedLibraries];
+            llvm::SMDiagnostic diagnostic;
+            std::unique_ptr<llvm::Module> library = llvm::parseIRFile(fileName, diagnostic, context.llvmContext);
+            if (!library) {
+                E("====> Error! Cannot load library \"" << fileName << "\", " << diagnostic.getMessage().str());
+                abortCompilation();
+            }
+            if (context.incremental) {
+                // A module of its own, so the session compiles it once; the identifier changes with the file.
+                llvm::sys::fs::file_status status;
+                llvm::sys::fs::status(fileName, status);
+                library->setModuleIdentifier("lib;" + fileName + ";" + std::to_string(
+                        status.getLastModificationTime().time_since_epoch().count()));
+                identifiers.push_back(library->getModuleIdentifier());
+                addToSession(library.release());
+                continue;
+            }
+            for (auto &value : library->global_values()) {
+                if (value.hasName() && !value.isDeclaration() && !value.hasLocalLinkage())
+                    librarySymbols.insert(value.getName());
+            }
+            if (llvm::Linker::linkModules(*context.module, std::move(library))) {
+                E("====> Error! Cannot link library \"" << fileName << "\".");
+                abortCompilation();
+            }
+        }
+        // Library code is private to this program now, so the optimizer may inline it across module boundaries and
+        // drop whatever is left unused. Only once all of them are in: a library links against the ones it imports.
+        if (!librarySymbols.empty()) {
+            llvm::internalizeModule(*context.module, [&librarySymbols](const llvm::GlobalValue &value) {
+                return !value.hasName() || !librarySymbols.count(value.getName());
+            });
+        }
+        return identifiers;
+    }
+
+    void Tools::addToSession(llvm::Module *module) {
+        // Every call hands one more small module to the same engine; modules added earlier stay compiled.
+        bool isCurrent = !module;
+        if (isCurrent) module = context.module;
+        if (!executionEngine) {
+            createExecutionEngine(module);
+        } else {
+            executionEngine->addModule(std::unique_ptr<llvm::Module>(module));
+        }
+        if (isCurrent) context.commitModule();
+    }
+
+    long long Tools::runIncremental(llvm::Function *function) {
+        std::string name = function->getName().str();
+        addToSession();
+        return callFunction(name);
+    }
+
+    long long Tools::callFunction(const std::string &name) {
+        executionEngine->finalizeObject();
+        auto address = executionEngine->getFunctionAddress(name);
+        if (!address) {
+            E("====> Error! Cannot find compiled function \"" << name << "\".");
+            return 0;
+        }
+        return reinterpret_cast<long long (*)()>(address)();
+    }
+
+    void Tools::closeSession() {
+        // The engine owns the target machine and every module handed to it.
+        delete executionEngine;
+        executionEngine = nullptr;
+        targetMachine = nullptr;
+    }
+
+    Block *Tools::parseSource(const std::string &source) {
+        FILE *input = fmemopen(const_cast<char *>(source.data()), source.size(), "r");
+        if (!input) return nullptr;
+        yylineno = 1;
+        yylloc = YYLTYPE();
+        mainBlock = nullptr;
+        yyrestart(input);
+        int failed;
+        try {
+            failed = yyparse();
+        } catch (CompileError &) {
+            fclose(input);
+            throw;
+        }
+        fclose(input);
+        return failed ? nullptr : mainBlock;
+    }
+
+    void Tools::attachDebugLocation(Context &context, llvm::BasicBlock *block, llvm::Instruction *after,
+                                    const YYLTYPE &location) {
+        llvm::Function *function = block->getParent();
+        if (!function->getSubprogram()) return;
+        auto *debugLocation = llvm::DILocation::get(context.llvmContext, (unsigned) location.first_line,
+                                                    (unsigned) location.first_column, function->getSubprogram());
+        // Instructions of a statement are appended to the block it started in and to blocks created after it.
+        for (auto basicBlock = block->getIterator(); basicBlock != function->end(); ++basicBlock) {
+            auto instruction = basicBlock == block->getIterator() && after ? std::next(after->getIterator())
+                                                                          : basicBlock->begin();
+            for (; instruction != basicBlock->end(); ++instruction)
+                if (!instruction->getDebugLoc()) instruction->setDebugLoc(debugLocation);
+        }
+    }
+
+    void Tools::declareDebugVariable(Context &context, llvm::Value *variable, llvm::Type *valueType,
+                                     const Identifier &name) {
+        if (!context.debugBuilder) return;
+        llvm::DIType *type = context.getDebugType(valueType);
+        if (auto *global = llvm::dyn_cast<llvm::GlobalVariable>(variable)) {
+            global->addDebugInfo(context.debugBuilder->createGlobalVariableExpression(
+                    context.debugUnit, name.name, name.name, context.debugFile, (unsigned) name.location.first_line,
+                    type, global->hasLocalLinkage()));
+            return;
+        }
+        llvm::DISubprogram *scope = context.getCurrentBlock()->getParent()->getSubprogram();
+        if (!scope) return;
+        auto *debugVariable = context.debugBuilder->createAutoVariable(scope, name.name, context.debugFile,
+                                                                       (unsigned) name.location.first_line, type);
+        context.debugBuilder->insertDeclare(variable, debugVariable, context.debugBuilder->createExpression(),
+                                            llvm::DILocation::get(context.llvmContext,
+                                                                  (unsigned) name.location.first_line,
+                                                                  (unsigned) name.location.first_column, scope),
+                                            context.getCurrentBlock());
+    }
+
+    llvm::DISubprogram *Tools::createDebugFunction(Context &context, llvm::Function *function,
+                                                   const YYLTYPE &location) {
+        if (!context.debugBuilder) return nullptr;
+        std::vector<llvm::Metadata *> types;
+        types.push_back(context.getDebugType(function->getReturnType()));
+        for (auto &argument : function->args()) types.push_back(context.getDebugType(argument.getType()));
+        llvm::DISubprogram *subprogram = context.debugBuilder->createFunction(
+                context.debugFile, function->getName(), function->getName(), context.debugFile,
+                (unsigned) location.first_line,
+                context.debugBuilder->createSubroutineType(context.debugBuilder->getOrCreateTypeArray(types)),
+                (unsigned) location.first_line, llvm::DINode::FlagPrototyped, llvm::DISubprogram::SPFlagDefinition);
+        function->setSubprogram(subprogram);
+        return subprogram;
+    }
+
     llvm::Type *Tools::typeOf(const ucml::Identifier &type, llvm::LLVMContext &llvmContext) {
-        if (type.name == "int") {
+        return typeOf(type.name, llvmContext);
+    }
+
+    llvm::Type *Tools::typeOf(const std::string &typeName, llvm::LLVMContext &llvmContext) {
+        if (typeName == "int") {
             return llvm::Type::getInt64Ty(llvmContext);
-        } else if (type.name == "double") {
+        } else if (typeName == "i32") {
+            return llvm::Type::getInt32Ty(llvmContext);
+        } else if (typeName == "i8") {
+            return llvm::Type::getInt8Ty(llvmContext);
+        } else if (typeName == "double") {
             return llvm::Type::getDoubleTy(llvmContext);
-        } else if (type.name == "void") {
+        } else if (typeName == "float") {
+            return llvm::Type::getFloatTy(llvmContext);
+        } else if (typeName == "bool") {
+            return llvm::Type::getInt1Ty(llvmContext);
+        } else if (typeName == "void") {
             return llvm::Type::getVoidTy(llvmContext);
+        } else if (typeName == "task") {
+            return llvm::Type::getInt8PtrTy(llvmContext);
         }
         return nullptr;
     }
 
-    std::pair<llvm::Type *, llvm::Value *> *
-    Tools::getValueOfIdentifier(ucml::Context &context, const Identifier &identifier) {
-        if (context.getSymbols().find(identifier.name) != context.getSymbols().end()) {
-            return &context.getSymbols()[identifier.name];
-        } else {
-            Scope *parentScope = context.getCurrentScope();
-            while (parentScope->parent) {
-                if (parentScope->parent->symbols.find(identifier.name) != parentScope->parent->symbols.end()) {
-                    return &parentScope->parent->symbols[identifier.name];
-                }
-                parentScope = parentScope->parent;
+    std::string Tools::nameOf(llvm::Type *type) {
+        if (type->isIntegerTy(64)) return "int";
+        if (type->isIntegerTy(32)) return "i32";
+        if (type->isIntegerTy(8)) return "i8";
+        if (type->isIntegerTy(1)) return "bool";
+        if (type->isDoubleTy()) return "double";
+        if (type->isFloatTy()) return "float";
+        if (type->isVoidTy()) return "void";
+        if (type == llvm::Type::getInt8PtrTy(type->getContext())) return "task";
+        return "";
+    }
+
+    bool Tools::isLiteralOf(llvm::Value *value, llvm::Type *type) {
+        if (auto *integer = llvm::dyn_cast<llvm::ConstantInt>(value)) {
+            if (type->isIntegerTy(1)) return integer->getValue().ule(1); // Not -1, though it fits a signed i1.
+            if (type->isIntegerTy()) return integer->getValue().isSignedIntN(type->getIntegerBitWidth());
+            return type->isFloatingPointTy();
+        }
+        return llvm::isa<llvm::ConstantFP>(value) && type->isFloatingPointTy();
+    }
+
+    llvm::Type *Tools::commonType(llvm::Value *left, llvm::Value *right) {
+        llvm::Type *leftType = left->getType(), *rightType = right->getType();
+        if (leftType == rightType) return leftType;
+        // A literal takes the type of the other operand, so "x * 2" stays i32 and "y * 0.5" stays float.
+        if (isLiteralOf(right, leftType)) return leftType;
+        if (isLiteralOf(left, rightType)) return rightType;
+        return commonType(leftType, rightType);
+    }
+
+    llvm::Type *Tools::commonType(llvm::Type *left, llvm::Type *right) {
+        // Floating point wins over integer, then the wider of the two wins.
+        if (left->isFloatingPointTy() != right->isFloatingPointTy()) return left->isFloatingPointTy() ? left : right;
+        return left->getPrimitiveSizeInBits() >= right->getPrimitiveSizeInBits() ? left : right;
+    }
+
+    llvm::Value *Tools::toCondition(Context &context, llvm::Value *value) {
+        // Any nonzero number is true.
+        llvm::Type *type = value->getType();
+        if (type->isIntegerTy(1)) return value;
+        llvm::IRBuilder<> builder(context.getCurrentBlock());
+        if (type->isFloatingPointTy()) return builder.CreateFCmpONE(value, llvm::ConstantFP::get(type, 0.0), "bool");
+        return builder.CreateICmpNE(value, llvm::ConstantInt::get(type, 0), "bool");
+    }
+
+    llvm::Value *Tools::castValue(Context &context, llvm::Value *value, llvm::Type *type, const YYLTYPE &location,
+                                  bool isExplicit) {
+        llvm::Type *valueType = value->getType();
+        if (valueType == type) return value;
+        llvm::IRBuilder<> builder(context.getCurrentBlock());
+        bool warn = !isExplicit && !isLiteralOf(value, type);
+        if (type->isIntegerTy(1) && (valueType->isIntegerTy() || valueType->isFloatingPointTy())) {
+            if (warn) W(location, "Converting " << nameOf(valueType) << " to bool.");
+            return toCondition(context, value);
+        }
+        if (valueType->isIntegerTy() && type->isIntegerTy()) {
+            if (valueType->getIntegerBitWidth() < type->getIntegerBitWidth()) {
+                return valueType->isIntegerTy(1) ? builder.CreateZExt(value, type, "widened")
+                                                 : builder.CreateSExt(value, type, "widened");
             }
+            if (warn) W(location, "Truncating " << nameOf(valueType) << " to fit " << nameOf(type) << ".");
+            return builder.CreateTrunc(value, type, "narrowed");
+        } else if (valueType->isFloatingPointTy() && type->isFloatingPointTy()) {
+            if (valueType->getPrimitiveSizeInBits() < type->getPrimitiveSizeInBits())
+                return builder.CreateFPExt(value, type, "widened");
+            if (warn) W(location, "Rounding " << nameOf(valueType) << " to fit " << nameOf(type) << ".");
+            return builder.CreateFPTrunc(value, type, "narrowed");
+        } else if (valueType->isIntegerTy() && type->isFloatingPointTy()) {
+            if (warn) W(location, "Converting integer to " << nameOf(type) << ".");
+            return valueType->isIntegerTy(1) ? builder.CreateUIToFP(value, type, "casted")
+                                             : builder.CreateSIToFP(value, type, "casted");
+        } else if (valueType->isFloatingPointTy() && type->isIntegerTy()) {
+            if (!isExplicit) W(location, "Truncating " << nameOf(valueType) << " to fit " << nameOf(type) << ".");
+            return builder.CreateFPToSI(value, type, "casted");
         }
-        llvm::GlobalValue *globalValue = context.module->getNamedValue(identifier.name);
+        FATAL(location, "Cannot convert \"" << nameOf(valueType) << "\" to \"" << nameOf(type) << "\".");
+        return nullptr;
+    }
+
+    std::pair<llvm::Type *, llvm::Value *> *
+    Tools::getValueOfIdentifier(ucml::Context &context, const Identifier &identifier) {
+        if (auto *symbol = context.findSymbol(identifier.name)) return symbol;
+        auto global = context.globalSymbols.find(identifier.name);
+        if (global != context.globalSymbols.end()) return &global->second;
+        llvm::GlobalVariable *globalValue = context.getGlobal(identifier.name);
         if (globalValue) {
-            llvm::IRBuilder<> builder(context.getCurrentBlock());
-            llvm::Type *type = globalValue->getValueType();
-            return new std::pair<llvm::Type *, llvm::Value *>(type, globalValue);
+            return &(context.globalSymbols[identifier.name] = std::make_pair(globalValue->getValueType(), globalValue));
         }
         return nullptr;
     }
 
     bool Tools::isValidType(const std::string &typeName, bool isFunction) {
-        if (typeName == "int" || typeName == "double") return true;
+        if (typeName == "int" || typeName == "i32" || typeName == "i8" || typeName == "double" || typeName == "float" ||
+            typeName == "bool")
+            return true;
         return isFunction && typeName == "void";
     }
 }
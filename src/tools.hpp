@@ -16,35 +16,133 @@
 #ifndef UCML_TOOLS_H
 #define UCML_TOOLS_H
 
+#include <string>
+#include <vector>
+#include <stdexcept>
 #include <llvm/Support/TargetSelect.h>
+#include <llvm/Target/TargetMachine.h>
 #include <llvm/ExecutionEngine/GenericValue.h>
+#include <llvm/ExecutionEngine/ExecutionEngine.h>
 #include "context.hpp"
 #include "nodes.hpp"
 
 #define P(s) std::cout << s << "\n"
 #define E(s) std::cerr << s << "\n"
 #define W(loc, msg) std::cerr << "W:L" << loc.first_line << ":C" << loc.first_column << ":" << msg << "\n"
-#define FATAL(loc, msg) std::cerr << "E:L" << loc.first_line << ":C" << loc.first_column << ":" << msg << "\n"; exit(1)
+#define FATAL(loc, msg) std::cerr << "E:L" << loc.first_line << ":C" << loc.first_column << ":" << msg << "\n"; \
+    ucml::Tools::abortCompilation()
 
 namespace ucml {
+    class Options {
+    public:
+        std::string cpu;      // -mcpu=<name>, "native" means the host CPU, empty means generic.
+        std::string features; // -mattr=<+feature,-feature,...>
+        unsigned optLevel{0}; // -O<n>
+        std::vector<std::string> importPaths; // -I<directory>
+        bool debugInfo{false};                // -g
+        unsigned threads{0};                  // --threads=<n>, run n copies of the program at once.
+        unsigned tierUpAfter{0};              // --tiered[=<n>], recompile functions called or looping n times...
+        unsigned tierLevel{0};                // ... at this level, while the program starts at -O0.
+        std::string sourceFile;
+    };
+
+    class CompileError : public std::runtime_error {
+    public:
+        CompileError() : std::runtime_error("compilation aborted") {}
+    };
+
     class Tools {
         Context &context;
         Block *codeBlock;
+        Options options;
+        llvm::TargetMachine *targetMachine;
+        llvm::ExecutionEngine *executionEngine;
+        llvm::ObjectCache *objectCache;
+
+        void createExecutionEngine(llvm::Module *module);
+
     public:
-        explicit Tools(Context &context, Block *codeBlock);
+        // When set, FATAL errors throw CompileError instead of terminating the process (used by the REPL).
+        static bool recoverErrors;
+
+        [[noreturn]] static void abortCompilation();
+
+        explicit Tools(Context &context, Block *codeBlock, const Options &options);
 
-        static Tools initialize(Block *codeBlock, Context &context);
+        static Tools initialize(Block *codeBlock, Context &context, const Options &options = Options());
+
+        void prepareModule();
 
         void createBuiltInFunctions();
 
-        llvm::Function *generateCode();
+        void createBatchFunctions();
+
+        static bool isBatchFunction(const llvm::Function &function);
+
+        void setCodeBlock(Block *block);
+
+        llvm::Function *generateCode(const std::string &entryName = "main");
+
+        void optimize(llvm::Function *mainFunction);
 
         void printIR(llvm::raw_ostream &oStream);
 
+        bool emitBitcode(const std::string &fileName);
+
+        llvm::Function *loadProgram(const std::string &fileName);
+
+        bool emitObject(llvm::Function *mainFunction, const std::string &fileName);
+
         llvm::GenericValue runCode(llvm::Function *function);
 
+        void runConcurrently(llvm::Function *mainFunction, unsigned threads);
+
+        void runTiered(llvm::Function *mainFunction);
+
+        std::vector<std::string> linkLibraries();
+
+        void addToSession(llvm::Module *module = nullptr);
+
+        long long runIncremental(llvm::Function *function);
+
+        long long callFunction(const std::string &name);
+
+        void closeSession();
+
+        std::string targetIdentity() const;
+
+        const Options &getOptions() const;
+
+        void setObjectCache(llvm::ObjectCache *cache);
+
+        static Block *parseSource(const std::string &source);
+
+        static void attachDebugLocation(Context &context, llvm::BasicBlock *block, llvm::Instruction *after,
+                                        const YYLTYPE &location);
+
+        static void declareDebugVariable(Context &context, llvm::Value *variable, llvm::Type *type,
+                                         const Identifier &name);
+
+        static llvm::DISubprogram *createDebugFunction(Context &context, llvm::Function *function,
+                                                       const YYLTYPE &location);
+
         static llvm::Type *typeOf(const Identifier &type, llvm::LLVMContext &llvmContext);
 
+        static llvm::Type *typeOf(const std::string &typeName, llvm::LLVMContext &llvmContext);
+
+        static std::string nameOf(llvm::Type *type);
+
+        static bool isLiteralOf(llvm::Value *value, llvm::Type *type);
+
+        static llvm::Type *commonType(llvm::Value *left, llvm::Value *right);
+
+        static llvm::Type *commonType(llvm::Type *left, llvm::Type *right);
+
+        static llvm::Value *toCondition(Context &context, llvm::Value *value);
+
+        static llvm::Value *castValue(Context &context, llvm::Value *value, llvm::Type *type, const YYLTYPE &location,
+                                      bool isExplicit = false);
+
         static std::pair<llvm::Type *, llvm::Value *> *getValueOfIdentifier(Context &context, const Identifier &name);
 
         static bool isValidType(const std::string &typeName, bool isFunction = false);
@@ -0,0 +1,212 @@
+/*
+   Copyright 2019 Atikur Rahman Chitholian
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+#include <set>
+#include <chrono>
+#include <thread>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <sys/stat.h>
+#include "watch.hpp"
+
+namespace ucml {
+    Watcher::Watcher(const std::string &fileName, const Options &options) : fileName(fileName), options(options),
+                                                                             builds(0) {}
+
+    int Watcher::run() {
+        Tools::recoverErrors = true;
+        struct stat status{};
+        struct timespec lastModified{};
+        off_t lastSize = -1;
+        std::cout << "====> Watching \"" << fileName << "\", press Ctrl+C to stop.\n";
+        while (true) {
+            if (stat(fileName.c_str(), &status) == 0 &&
+                (status.st_mtim.tv_sec != lastModified.tv_sec || status.st_mtim.tv_nsec != lastModified.tv_nsec ||
+                 status.st_size != lastSize)) {
+                lastModified = status.st_mtim;
+                lastSize = status.st_size;
+                std::ifstream file(fileName);
+                std::stringstream source;
+                source << file.rdbuf();
+                std::cout << "====> \"" << fileName << "\" changed, rebuilding...\n";
+                compileAndRun(source.str());
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        }
+    }
+
+    bool Watcher::compileAndRun(const std::string &source) {
+        auto startTime = std::chrono::steady_clock::now();
+        Block *block;
+        try {
+            block = Tools::parseSource(source);
+        } catch (CompileError &) {
+            return false;
+        }
+        if (!block) return false;
+
+        // Offsets of line starts, to cut the text of every definition out of the source.
+        std::vector<size_t> lines{0};
+        for (size_t i = 0; i < source.size(); ++i) if (source[i] == '\n') lines.push_back(i + 1);
+        auto textOf = [&](const YYLTYPE &location) {
+            if (location.first_line < 1 || location.last_line > (int) lines.size()) return source;
+            size_t begin = lines[location.first_line - 1] + location.first_column - 1,
+                    end = lines[location.last_line - 1] + location.last_column;
+            return source.substr(begin, end > begin ? end - begin : 0);
+        };
+
+        Context context(llvmContext);
+        context.incremental = true;
+        Tools tools = Tools::initialize(nullptr, context, options);
+        tools.setObjectCache(&cache);
+        std::string identity = tools.targetIdentity() + ";O" + std::to_string(tools.getOptions().optLevel);
+        std::set<std::string> used;
+        unsigned compiled = 0, reused = 0;
+        bool owned = true; // Whether "context.module" still belongs to us rather than to the JIT.
+
+        try {
+            // Signatures of everything callable plus the types of globals; a function's fingerprint includes the
+            // ones it refers to, so callers get rebuilt when a callee's signature changes.
+            std::map<std::string, std::string> signatures;
+            std::vector<FunctionDeclaration *> definitions;
+            auto *script = new Block();
+            for (size_t i = 0; i < block->statements.size(); ++i) {
+                Statement *statement = block->statements[i];
+                auto *function = dynamic_cast<FunctionDeclaration *>(statement);
+                auto *variable = dynamic_cast<VariableDeclaration *>(statement);
+                if (function && function->typeParameters) {
+                    // Instantiated inside every module calling it, so callers depend on its whole text.
+                    signatures[function->identifier.name] = "<>" + fingerprint(textOf(function->location));
+                } else if (function) {
+                    std::string signature = "(";
+                    if (function->parameters) {
+                        for (auto *parameter : *function->parameters)
+                            signature += parameter->type.name + ",";
+                    }
+                    signatures[function->identifier.name] = signature + "):" + function->type.name;
+                    if (!function->isExternal) {
+                        for (auto *definition : definitions) {
+                            if (definition->identifier.name == function->identifier.name) {
+                                FATAL(function->location, "Function with name \"" << function->identifier.name
+                                                                                  << "\" is already defined.");
+                            }
+                        }
+                        definitions.push_back(function);
+                        if (function->isGenerator())
+                            context.generators[function->identifier.name] = function->type.name;
+                        context.declareFunction(function->identifier.name, function->getFunctionType(context));
+                        continue;
+                    }
+                } else if (variable) {
+                    signatures[variable->identifier.name] = ":" + variable->type.name;
+                }
+                script->statements.push_back(statement);
+                if (i < block->locations.size()) script->locations.push_back(block->locations[i]);
+            }
+
+            tools.createBuiltInFunctions();
+            context.module->setModuleIdentifier("builtins;" + identity);
+            used.insert(context.module->getModuleIdentifier());
+            tools.addToSession();
+            owned = false;
+
+            // Top-level statements depend on everything (imported libraries included), they are always rebuilt.
+            context.startModule("script;" + std::to_string(++builds));
+            owned = true;
+            tools.prepareModule();
+            tools.setCodeBlock(script);
+            llvm::Function *mainFunction = tools.generateCode("main");
+            tools.optimize(mainFunction);
+            used.insert(context.module->getModuleIdentifier());
+            tools.addToSession();
+            owned = false;
+            for (auto &library : tools.linkLibraries()) used.insert(library);
+            // Functions may call into imported libraries, a changed interface invalidates them all.
+            for (auto &library : context.libraries) {
+                std::ifstream interface(library.substr(0, library.size() - 3) + ".mli");
+                std::stringstream text;
+                text << interface.rdbuf();
+                identity += ";" + fingerprint(text.str());
+            }
+
+            for (auto *definition : definitions) {
+                const std::string &name = definition->identifier.name;
+                std::string text = textOf(definition->location);
+                std::string key = identity + "|" + text;
+                std::set<std::string> references;
+                for (size_t i = 0; i < text.size();) {
+                    if (isalpha(text[i]) || text[i] == '_') {
+                        size_t begin = i;
+                        while (i < text.size() && (isalnum(text[i]) || text[i] == '_')) ++i;
+                        references.insert(text.substr(begin, i - begin));
+                    } else if (isdigit(text[i])) {
+                        while (i < text.size() && (isalnum(text[i]) || text[i] == '.')) ++i;
+                    } else ++i;
+                }
+                for (auto &reference : references) {
+                    auto signature = signatures.find(reference);
+                    if (signature != signatures.end()) key += "|" + reference + signature->second;
+                }
+
+                context.startModule("def;" + name + ";" + fingerprint(key));
+                owned = true;
+                tools.prepareModule();
+                if (cache.contains(context.module->getModuleIdentifier())) {
+                    ++reused; // An empty module is enough, the JIT takes the object code from the cache.
+                } else {
+                    ++compiled;
+                    context.forgetFunction(name);
+                    context.createNewScope(); // The global scope, so locals of the function stay local.
+                    auto *function = llvm::cast<llvm::Function>(definition->generateCode(context));
+                    context.closeCurrentScope();
+                    tools.optimize(function);
+                }
+                used.insert(context.module->getModuleIdentifier());
+                tools.addToSession();
+                owned = false;
+            }
+        } catch (CompileError &) {
+            if (owned) delete context.module;
+            tools.closeSession();
+            return false;
+        }
+
+        auto compileTime = std::chrono::steady_clock::now();
+        tools.callFunction("main");
+        fflush(stdout);
+        tools.closeSession();
+        cache.retainOnly(used);
+        auto endTime = std::chrono::steady_clock::now();
+        std::cout << "====> " << compiled << " function(s) recompiled, " << reused << " reused; build "
+                  << std::chrono::duration_cast<std::chrono::milliseconds>(compileTime - startTime).count()
+                  << " ms, run "
+                  << std::chrono::duration_cast<std::chrono::milliseconds>(endTime - compileTime).count()
+                  << " ms.\n";
+        return true;
+    }
+
+    std::string Watcher::fingerprint(const std::string &text) {
+        // 64-bit FNV-1a, stable across runs and platforms.
+        unsigned long long hash = 14695981039346656037ULL;
+        for (unsigned char c : text) {
+            hash ^= c;
+            hash *= 1099511628211ULL;
+        }
+        char digits[17];
+        snprintf(digits, sizeof(digits), "%016llx", hash);
+        return digits;
+    }
+}
@@ -0,0 +1,47 @@
+/*
+   Copyright 2019 Atikur Rahman Chitholian
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+#ifndef UCML_WATCH_H
+#define UCML_WATCH_H
+
+#include <map>
+#include <string>
+#include "tools.hpp"
+#include "cache.hpp"
+
+namespace ucml {
+    /**
+     * Watches a source file and re-runs it on every change. Each top-level "def" is compiled into a module of its own
+     * whose identifier is a fingerprint of its source text plus the signatures and global variables it refers to;
+     * unchanged functions are loaded from the object cache, only changed ones are generated, optimized and compiled.
+     */
+    class Watcher {
+        std::string fileName;
+        Options options;
+        llvm::LLVMContext llvmContext;
+        ObjectCache cache;
+        unsigned builds;
+    public:
+        Watcher(const std::string &fileName, const Options &options);
+
+        int run();
+
+        bool compileAndRun(const std::string &source);
+
+        static std::string fingerprint(const std::string &text);
+    };
+}
+
+#endif
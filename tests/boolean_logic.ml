@@ -0,0 +1,35 @@
+/**
+*  bool type with short-circuit && and || and negation !
+*/
+calls:int = 0
+
+def touch(result:bool):bool => {
+    calls = calls + 1
+    return result
+}
+
+def between(x:int, low:int, high:int):bool => {
+    return x >= low && x <= high
+}
+
+ready:bool = true
+echo(ready)                             // 1
+echo(!ready)                            // 0
+echo(between(5, 1, 10))                 // 1
+echo(between(11, 1, 10) || !false)      // 1
+
+if (false && touch(true)) {             // touch() is never called
+    echo(-1)
+}
+if (true || touch(false)) {             // touch() is never called
+    echo(calls)                         // 0
+}
+if (touch(true) && touch(false)) {
+    echo(-1)
+} else {
+    echo(calls)                         // 2
+}
+echo(ready > 0)                         // 1, a bool counts as 0 or 1
+echo(true > false)                      // 1
+echo(ready == -1)                       // 0
+echo(ready + ready)                     // 2
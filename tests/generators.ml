@@ -0,0 +1,32 @@
+/**
+*  generators: functions that yield values to a for loop
+*/
+def evens(limit:int):int => {
+    for (i:int in 0 to limit by 2) {
+        yield i
+    }
+}
+
+def squares(limit:int):double => {
+    for (x:int in evens(limit)) {
+        yield x * x
+    }
+}
+
+def firstAbove(limit:int, threshold:double):double => {
+    for (y:double in squares(limit)) {
+        if (y > threshold) {
+            return y                    // destroys both generators
+        }
+    }
+    return -1
+}
+
+for (x:int in evens(6)) {
+    echo(x)                             // 0 2 4 6
+}
+for (y:double in squares(4)) {
+    echo(y)                             // 0.0 4.0 16.0
+}
+echo(firstAbove(100, 50))               // 64.0
+echo(firstAbove(4, 50))                 // -1.0
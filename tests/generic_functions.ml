@@ -0,0 +1,18 @@
+/**
+*  Generic functions are specialized for the argument types of every call
+*/
+def maximum<T>(a:T, b:T):T => {
+    if (a > b) {
+        return a
+    }
+    return b
+}
+
+def scale<T, F>(value:T, factor:F):T => {
+    return value * factor
+}
+
+echo(maximum(3, 7))         // maximum<int>
+echo(maximum(2.5, 1.5))     // maximum<double>
+echo(scale(10, 2))          // scale<int,int>
+echo(scale(1.5, 4))         // scale<double,int>
@@ -0,0 +1,12 @@
+/**
+*  A library importing another one ("mathlib"), used by "import_transitive.ml".
+*/
+import mathlib
+
+def area(side:int):int => {
+    return square(side)
+}
+
+def diagonal(a:double, b:double):double => {
+    return hypotenuse(a, b)
+}
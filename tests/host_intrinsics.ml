@@ -0,0 +1,13 @@
+/**
+*  host helpers: inlined from IR (hash, clamp) or bound natively (hash_native, clamp_native)
+*/
+extern hash(x:int):int
+extern hash_native(x:int):int
+extern clamp(x:double, low:double, high:double):double
+extern clamp_native(x:double, low:double, high:double):double
+
+echo(hash(42) == hash_native(42))       // 1
+echo(hash(0))                           // 0
+echo(clamp(5.5, 0, 1))                  // 1.0
+echo(clamp_native(-2, 0, 1))            // 0.0
+echo(clamp(0.25, 0, 1) == clamp_native(0.25, 0, 1))    // 1
@@ -0,0 +1,8 @@
+/**
+*  Functions and globals of a precompiled library; only "mathlib.mli" is read here.
+*/
+import mathlib
+
+echo(square(7)) // prints 49
+echo(hypotenuse(3.0, 4.0)) // prints 5.000000
+echo(calls) // prints 1
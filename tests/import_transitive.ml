@@ -0,0 +1,8 @@
+/**
+*  A library that imports another: both are linked into the program before anything is internalized.
+*/
+import geometry
+
+echo(area(6)) // prints 36
+echo(diagonal(6.0, 8.0)) // prints 10.000000
+echo(calls) // prints 1, mathlib's global is shared through geometry
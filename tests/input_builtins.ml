@@ -0,0 +1,23 @@
+/**
+*  Input builtins on an empty stdin (the tests run with stdin from /dev/null).
+*/
+def count():int => {
+    n:int = 0
+    for (i:int in 1 to 100) {
+        if (ended()) {
+            return n
+        }
+        n = n + 1
+        readint(0)
+    }
+    return n
+}
+
+echo(count())
+echo(ended(0))
+echo(rows(0))
+x:double = readdouble()
+echo(x)
+if (rows(0) > 0) {
+    echo(intat(0, 0))
+}
@@ -0,0 +1,24 @@
+/**
+*  unroll / vectorize / interleave hints on for loops (honoured from -O1)
+*/
+def sum(n:int):double => {
+    total:double = 0
+    for (i:int in 1 to n) vectorize(4) interleave(2) {
+        total = total + double(i) * 0.5
+    }
+    return total
+}
+
+def countdown(n:int):int => {
+    steps:int = 0
+    for (k:int in n to 1 by -1) unroll(8) {
+        steps = steps + 1
+    }
+    return steps
+}
+
+echo(sum(100))                          // 2525.0
+echo(countdown(20))                     // 20
+for (j:int in 1 to 3) unroll(1) {       // keep the loop rolled
+    echo(j)                             // 1 2 3
+}
@@ -0,0 +1,9 @@
+/**
+*  match: a constant label that does not fit the subject's type is rejected, not truncated.
+*  Expected to fail with "Case label 300 does not fit in the i8 being matched." (on i8, 300 would alias 44).
+*/
+opcode:i8 = 44
+match (opcode) {
+    0 to 300 => { echo(1) }
+    _ => { echo(0) }
+}
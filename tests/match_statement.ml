@@ -0,0 +1,37 @@
+/**
+*  match: multi-way dispatch on integers, lowered to a single switch
+*/
+def classify(code:int):int => {
+    match (code) {
+        0 => { return 100 }
+        1, 2, 3 => { return 200 }
+        10 to 19 => { return 300 }
+        -5 to -1 => { return -1 }
+        _ => { return 0 }
+    }
+    return 0
+}
+
+echo(classify(0))                       // 100
+echo(classify(2))                       // 200
+echo(classify(15))                      // 300
+echo(classify(-3))                      // -1
+echo(classify(42))                      // 0
+
+opcode:i8 = 4
+match (opcode) {
+    4 to 6 => {
+        seen:int = 1                    // scoped to this case
+        echo(seen)                      // 1
+    }
+    7 => {
+        echo(7)
+    }
+    -128 to -100, 127 => {              // the whole i8 range is allowed, nothing beyond it
+        echo(0)
+    }
+}
+match (opcode > 3) {
+    true => { echo(1) }                 // 1
+    false => { echo(0) }
+}
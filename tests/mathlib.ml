@@ -0,0 +1,16 @@
+/**
+*  A small library used by "import_library.ml".
+*  Build it once with "uCML --emit-lib mathlib.ml", or let the first import build it.
+*/
+extern sqrt(x:double):double
+
+calls:int = 0 // Exported global, initialized when the library is imported.
+
+def square(x:int):int => {
+    calls = calls + 1
+    return x * x
+}
+
+def hypotenuse(a:double, b:double):double => {
+    return sqrt(a * a + b * b)
+}
@@ -0,0 +1,26 @@
+/**
+*  Narrow numeric types: i32, i8 and float next to int (i64) and double (f64)
+*/
+def average(a:float, b:float):float => {
+    return (a + b) / 2      // literals take the type of the other operand
+}
+
+def wrap(x:i32):i8 => {
+    return i8(x)            // explicit narrowing, no warning
+}
+
+small:i8 = 100
+count:i32 = 7
+ratio:float = 0.25
+
+echo(count * 3)             // stays i32
+echo(small + count)         // i8 widens to i32
+echo(average(ratio, 1.75))
+echo(wrap(300))             // 300 does not fit i8, wraps to 44
+echo(double(ratio) * 2.0)   // explicit widening
+
+sum:i32 = 0
+for(i:i32 in 1 to 10) {
+    sum = sum + i
+}
+echo(sum)
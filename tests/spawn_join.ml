@@ -0,0 +1,35 @@
+/**
+*  Tasks: "spawn f(x)" starts f on the work-stealing scheduler, "join(t)" waits for it and returns its result.
+*/
+def fib(n:int):int => {
+    if (n < 2) {
+        return n
+    }
+    left:task = spawn fib(n - 1)
+    right:int = fib(n - 2)
+    return join(left) + right
+}
+
+def half(x:double):double => {
+    return x / 2
+}
+
+def report(x:int):void => {
+    echo(x)
+}
+
+def both(a:double, b:double):double => {
+    first:task = spawn half(a)
+    second:task = spawn half(b)
+    return join(first) + join(second)
+}
+
+def run():void => {
+    done:task = spawn report(7)
+    join(done)
+}
+
+echo(fib(20))      // 6765
+echo(both(3, 5))   // 4
+echo(join(spawn half(9)))
+run()
@@ -0,0 +1,19 @@
+/**
+*  Tasks under --threads: every run keeps its tasks, and so its own copy of the globals, on its thread.
+*  options: --threads=4 --workers=4
+*/
+total:int = 0
+
+def add(n:int):void => {
+    total = total + n
+}
+
+def addAll(n:int):void => {
+    for (i:int in 1 to n) {
+        t:task = spawn add(i)
+        join(t)
+    }
+}
+
+addAll(100)
+echo(total)   // 5050 on every thread